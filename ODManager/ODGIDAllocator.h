@@ -0,0 +1,105 @@
+//
+//  ODGIDAllocator.h
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+@class ODNode;
+
+/**
+ *  Bitmap of the group IDs in a range, preloaded from the node so new groups get free IDs without a lookup each.
+ *  @discussion safe to share between threads.  An ID handed out is marked used right away, so concurrent creates never get the same one.
+ */
+@interface ODGIDAllocator : NSObject
+
+@property (readonly) NSUInteger firstID;
+@property (readonly) NSUInteger lastID;
+
+/**
+ *  number of IDs in the range that are still free
+ */
+@property (readonly) NSUInteger available;
+
+/**
+ *  allocator for 1025 through 65535, the range used by directory groups
+ */
+- (id)init;
+- (id)initWithFirstID:(NSUInteger)firstID lastID:(NSUInteger)lastID;
+
+/**
+ *  the ID in a string such as a requested ODGroup gid, NSNotFound unless it is a whole positive number
+ */
++ (NSUInteger)IDFromString:(NSString*)string;
+
+/**
+ *  Mark every PrimaryGroupID on the node as used
+ *
+ *  @param node  node to read the groups from
+ *  @param error populated should error occur
+ *
+ *  @return YES for success, NO on failure.
+ */
+- (BOOL)loadFromNode:(ODNode*)node error:(NSError**)error;
+
+/**
+ *  YES once the node has been read and nothing has asked for it to be read again
+ */
+@property (readonly, getter=isLoaded) BOOL loaded;
+
+/**
+ *  Read the node unless that has already been done.  Concurrent callers wait for a single read
+ *
+ *  @param node  node to read the groups from
+ *  @param error populated should error occur
+ *
+ *  @return YES for success, NO on failure.
+ */
+- (BOOL)loadIfNeededFromNode:(ODNode*)node error:(NSError**)error;
+
+/**
+ *  read the node again on the next loadIfNeededFromNode:error:.  IDs already used or handed out stay used
+ */
+- (void)setNeedsLoad;
+
+/**
+ *  mark IDs as used, strings or numbers.  IDs outside the range are ignored
+ */
+- (void)markUsed:(id<NSFastEnumeration>)gids;
+
+/**
+ *  claim a specific ID, NO if it is already used or handed out.
+ *  @discussion IDs outside the range are only tracked once claimed here, so the caller must check the node for them first
+ */
+- (BOOL)claimID:(NSUInteger)gid;
+
+/**
+ *  the lowest free ID after the last one handed out, NSNotFound when the range is full
+ */
+- (NSUInteger)allocateID;
+
+/**
+ *  return an ID whose group was never created or has been removed
+ */
+- (void)releaseID:(NSUInteger)gid;
+
+@end
@@ -0,0 +1,239 @@
+//
+//  ODGIDAllocator.m
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "ODGIDAllocator.h"
+#import "ODManagerRecord.h"
+#import <OpenDirectory/OpenDirectory.h>
+#import <pthread.h>
+
+static NSUInteger const kODMFirstGroupID = 1025;
+static NSUInteger const kODMLastGroupID = 65535;
+
+@implementation ODGIDAllocator {
+    pthread_mutex_t _lock;
+    NSLock* _loadLock;
+    BOOL _loaded;
+    /* IDs outside the range that were claimed here, the bitmap only covers the range */
+    NSMutableIndexSet* _outside;
+    uint64_t* _words;
+    NSUInteger _wordCount;
+    NSUInteger _used;
+    /* word the next search starts from, IDs are handed out in increasing order */
+    NSUInteger _cursor;
+}
+
+- (id)init
+{
+    return [self initWithFirstID:kODMFirstGroupID lastID:kODMLastGroupID];
+}
+
+- (id)initWithFirstID:(NSUInteger)firstID lastID:(NSUInteger)lastID
+{
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&_lock, NULL);
+        _loadLock = [NSLock new];
+        _outside = [NSMutableIndexSet new];
+        _firstID = firstID;
+        _lastID = MAX(firstID, lastID);
+        NSUInteger bits = _lastID - _firstID + 1;
+        _wordCount = (bits + 63) / 64;
+        _words = calloc(_wordCount, sizeof(uint64_t));
+
+        /* bits past lastID in the final word are never free */
+        NSUInteger spare = _wordCount * 64 - bits;
+        if (spare) {
+            _words[_wordCount - 1] = ~0ULL << (64 - spare);
+        }
+    }
+    return self;
+}
+
++ (NSUInteger)IDFromString:(NSString*)string
+{
+    if (![string isKindOfClass:[NSString class]]) {
+        return NSNotFound;
+    }
+    NSScanner* scanner = [NSScanner scannerWithString:string];
+    NSInteger value;
+    if (![scanner scanInteger:&value] || !scanner.isAtEnd || value <= 0) {
+        return NSNotFound;
+    }
+    return value;
+}
+
+- (void)dealloc
+{
+    free(_words);
+    pthread_mutex_destroy(&_lock);
+}
+
+- (BOOL)loadFromNode:(ODNode*)node error:(NSError* __autoreleasing*)error
+{
+    NSDictionary* groups = [ODManagerRecord recordsOfType:kODRecordTypeGroups
+                                               attributes:@[ kODAttributeTypeRecordName, kODAttributeTypePrimaryGroupID ]
+                                                     node:node
+                                                    error:error];
+    if (!groups) {
+        return NO;
+    }
+
+    NSMutableArray* gids = [NSMutableArray arrayWithCapacity:groups.count];
+    for (ODRecord* record in groups.allValues) {
+        NSString* gid = [[record valuesForAttribute:kODAttributeTypePrimaryGroupID error:nil] lastObject];
+        if (gid) {
+            [gids addObject:gid];
+        }
+    }
+    [self markUsed:gids];
+    pthread_mutex_lock(&_lock);
+    _loaded = YES;
+    pthread_mutex_unlock(&_lock);
+    return YES;
+}
+
+- (BOOL)isLoaded
+{
+    pthread_mutex_lock(&_lock);
+    BOOL loaded = _loaded;
+    pthread_mutex_unlock(&_lock);
+    return loaded;
+}
+
+- (BOOL)loadIfNeededFromNode:(ODNode*)node error:(NSError* __autoreleasing*)error
+{
+    if (self.loaded) {
+        return YES;
+    }
+    [_loadLock lock];
+    BOOL rc = self.loaded || [self loadFromNode:node error:error];
+    [_loadLock unlock];
+    return rc;
+}
+
+- (void)setNeedsLoad
+{
+    pthread_mutex_lock(&_lock);
+    _loaded = NO;
+    pthread_mutex_unlock(&_lock);
+}
+
+#pragma mark - Bits
+/* caller holds _lock */
+- (BOOL)setBit:(NSUInteger)gid
+{
+    if (gid < _firstID || gid > _lastID) {
+        return NO;
+    }
+    NSUInteger bit = gid - _firstID;
+    uint64_t mask = 1ULL << (bit % 64);
+    if (_words[bit / 64] & mask) {
+        return NO;
+    }
+    _words[bit / 64] |= mask;
+    _used++;
+    return YES;
+}
+
+- (void)markUsed:(id<NSFastEnumeration>)gids
+{
+    pthread_mutex_lock(&_lock);
+    for (id gid in gids) {
+        NSInteger value = [gid integerValue];
+        if (value > 0) {
+            [self setBit:value];
+        }
+    }
+    pthread_mutex_unlock(&_lock);
+}
+
+- (BOOL)claimID:(NSUInteger)gid
+{
+    BOOL claimed = NO;
+    pthread_mutex_lock(&_lock);
+    if (gid >= _firstID && gid <= _lastID) {
+        claimed = [self setBit:gid];
+    } else if (gid != NSNotFound && ![_outside containsIndex:gid]) {
+        [_outside addIndex:gid];
+        claimed = YES;
+    }
+    pthread_mutex_unlock(&_lock);
+    return claimed;
+}
+
+- (NSUInteger)allocateID
+{
+    NSUInteger gid = NSNotFound;
+    pthread_mutex_lock(&_lock);
+    for (NSUInteger i = 0; i < _wordCount; i++) {
+        NSUInteger index = (_cursor + i) % _wordCount;
+        uint64_t clear = ~_words[index];
+        if (clear) {
+            NSUInteger bit = __builtin_ctzll(clear);
+            _words[index] |= 1ULL << bit;
+            _used++;
+            _cursor = index;
+            gid = _firstID + index * 64 + bit;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&_lock);
+    return gid;
+}
+
+- (void)releaseID:(NSUInteger)gid
+{
+    if (gid < _firstID || gid > _lastID) {
+        pthread_mutex_lock(&_lock);
+        [_outside removeIndex:gid];
+        pthread_mutex_unlock(&_lock);
+        return;
+    }
+    NSUInteger bit = gid - _firstID;
+    uint64_t mask = 1ULL << (bit % 64);
+
+    pthread_mutex_lock(&_lock);
+    if (_words[bit / 64] & mask) {
+        _words[bit / 64] &= ~mask;
+        _used--;
+    }
+    pthread_mutex_unlock(&_lock);
+}
+
+- (NSUInteger)available
+{
+    pthread_mutex_lock(&_lock);
+    NSUInteger available = (_lastID - _firstID + 1) - _used;
+    pthread_mutex_unlock(&_lock);
+    return available;
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"ODGIDAllocator - %lu-%lu, %lu free",
+                                      (unsigned long)_firstID, (unsigned long)_lastID, (unsigned long)self.available];
+}
+
+@end
@@ -26,6 +26,11 @@
 #import <Foundation/Foundation.h>
 #import "ODSecureObjects.h"
 #import "ODManagerConstants.h"
+#import "ODManagerJob.h"
+#import "ODManagerReconciler.h"
+#import "ODStringPool.h"
+#import "ODManagerQuery.h"
+#import "ODManagerExporter.h"
 
 extern NSString* domainDescription(int domain);
 extern NSString* nodeStatusDescription(int status);
@@ -142,6 +147,12 @@ extern NSString* kODMPresetRecord;
  */
 @property (nonatomic,readonly ) BOOL authenticated;
 
+/**
+ *  pool that user and group queries intern repeated attribute values through, such as the login shell, primary group, home directory prefixes and share point.  nil by default
+ *  @discussion set a new ODStringPool before a full directory listing and read its counters afterwards; drop it once the listing is released
+ */
+@property (strong) ODStringPool *queryStringPool;
+
 -(id)initWithDelegate:(id<ODManagerDelegate>)delegate;
 -(id)initWithServer:(NSString*)server;
 -(id)initWithServer:(NSString *)server domain:(int)domain;
@@ -171,6 +182,37 @@ extern NSString* kODMPresetRecord;
 -(BOOL)refreshNode:(NSError**)error;
 -(BOOL)refreshNode;
 
+#pragma mark - Keepalive
+///------------------------------
+/// @name Keepalive
+///------------------------------
+
+/**
+ *  seconds between keepalive probes of the node, defaults to 60.  Takes effect the next time the keepalive starts
+ */
+@property (nonatomic) NSTimeInterval keepaliveInterval;
+
+/**
+ *  seconds after which the keepalive re-authenticates on a new connection, defaults to 900.  0 only re-authenticates after a failure
+ */
+@property (nonatomic) NSTimeInterval reauthenticateInterval;
+
+/**
+ *  whether the keepalive is running
+ */
+@property (readonly, getter=isKeepaliveRunning) BOOL keepaliveRunning;
+
+/**
+ *  Start probing the node and any replicas in the background so that user calls don't pay for connecting or authenticating
+ *  @discussion a node that stops answering is reconnected, and an authenticated connection is rebuilt once it is older than reauthenticateInterval.  The new connection is swapped in when it is ready, calls already running finish on the old one.  Replicas are reopened whenever one stops answering or a new session is published.
+ */
+-(void)startKeepalive;
+
+/**
+ *  Stop the background keepalive
+ */
+-(void)stopKeepalive;
+
 #pragma mark - Add Users
 ///------------------------------
 /// @name Add Users
@@ -190,8 +232,11 @@ extern NSString* kODMPresetRecord;
  *  Asynchronously add a list of users
  *
  *  @param users ODRecordList with the user property populated with an array of ODUser objects
- *  @param reply A block object to be executed when the request operation finishes. This block has no return value and takes one argument: NSError. */
--(void)addListOfUsers:(ODRecordList*)list
+ *  @param reply A block object to be executed when the request operation finishes. This block has no return value and takes one argument: NSError.
+ *
+ *  @return job handle for the import, nil if the node could not be authenticated
+ */
+-(ODManagerJob*)addListOfUsers:(ODRecordList*)list
                 reply:(void(^)(NSError *error))reply;
 
 /**
@@ -201,8 +246,10 @@ extern NSString* kODMPresetRecord;
  *  @param progress block object to be excuted when a user is added.  This block has no return value and takes two arguments, NSString and double
  *  @param reply A block object to be executed when the request operation finishes. This block has no return value and takes one argument: NSError.
  *  @discussion Use this when not implamenting a delegate.
+ *
+ *  @return job handle for the import, nil if the node could not be authenticated
  */
--(void)addListOfUsers:(ODRecordList*)list
+-(ODManagerJob*)addListOfUsers:(ODRecordList*)list
              progress:(void(^)(NSString* message,double progress))progress
                 reply:(void(^)(NSError *error))reply;
 /**
@@ -225,8 +272,10 @@ extern NSString* kODMPresetRecord;
  *  @param preset name of preset
  *  @param reply A block object to be executed when the request operation finishes. This block has no return value and takes one argument: NSError.
  *  @discussion use this when implementing a delegate
+ *
+ *  @return job handle for the import, nil if the node could not be authenticated
  */
--(void)addListOfUsers:(ODRecordList*)list
+-(ODManagerJob*)addListOfUsers:(ODRecordList*)list
            withPreset:(NSString*)preset
                 reply:(void(^)(NSError *error))reply;
 
@@ -237,14 +286,35 @@ extern NSString* kODMPresetRecord;
  *  @param preset name of preset
  *  @param progress block object to be excuted when a user is added.  This block has no return value and takes two arguments, NSString and double
  *  @param reply A block object to be executed when the request operation finishes. This block has no return value and takes one argument: NSError.
+ *
+ *  @return job handle for the import, nil if the node could not be authenticated
+ *  @discussion each call gets its own job, so imports into different OUs or servers can run at the same time.
  */
--(void)addListOfUsers:(ODRecordList*)list
+-(ODManagerJob*)addListOfUsers:(ODRecordList*)list
               withPreset:(NSString*)preset
                 progress:(void(^)(NSString* message,double progress))progress
                    reply:(void(^)(NSError *error))reply;
 
 /**
- *  Cancesl any add user list operation in progress.
+ *  Asynchronously add a list of users, logging each finished step to a journal so the import can be resumed
+ *
+ *  @param users       ODRecordList with the user property populated with an array of ODUser objects
+ *  @param preset      name of preset, may be nil
+ *  @param journalPath path of the journal file. It is created if needed; if it already exists the users it records as finished are skipped
+ *  @param progress    block object to be excuted when a user is added.  This block has no return value and takes two arguments, NSString and double
+ *  @param reply       A block object to be executed when the request operation finishes. This block has no return value and takes one argument: NSError.
+ *
+ *  @return job handle for the import, nil if the node could not be authenticated
+ *  @discussion after a crash or cancel, call again with the same list and path to continue where the import stopped.  Each user's intent to create is synced to the journal before the record is created, so a user that already exists is only taken over when an earlier run of this journal logged that intent; any other existing user fails with kODMerrUserAlreadyExists and its password is left alone.  Delete the journal once the import is done.
+ */
+-(ODManagerJob*)addListOfUsers:(ODRecordList*)list
+                    withPreset:(NSString*)preset
+                       journal:(NSString*)journalPath
+                      progress:(void(^)(NSString* message,double progress))progress
+                         reply:(void(^)(NSError *error))reply;
+
+/**
+ *  Cancesl every add user list operation in progress.  Use -[ODManagerJob cancel] to stop a single import.
  */
 -(void)cancelUserImport;
 #pragma mark - Remove Users
@@ -264,17 +334,66 @@ extern NSString* kODMPresetRecord;
 /**
  *  Asynchronously remove a list user from the OpenDirectory database
  *
- *  @param user  record name for the user.
- *  @param error populated should error occur
+ *  @param users  record names for the users.
+ *  @param reply A block object to be executed when the request operation finishes. This block has no return value and takes one argument: NSError.
  *
- *  @return YES for success, NO on failure.
+ *  @return job handle for the removal, nil if the node could not be authenticated
  */
--(void)removeUsers:(NSArray*)users reply:(void(^)(NSError *error))reply;
+-(ODManagerJob*)removeUsers:(NSArray*)users reply:(void(^)(NSError *error))reply;
+
+/**
+ *  Asynchronously remove a list of users, optionally taking them out of every group they belong to
+ *
+ *  @param users            record names for the users.
+ *  @param cleanMemberships YES to remove GroupMembership and GroupMembers entries for the removed users
+ *  @param progress         block object to be excuted when a user is removed.  This block has no return value and takes two arguments, NSString and double
+ *  @param reply            A block object to be executed when the request operation finishes. This block has no return value and takes one argument: NSError.
+ *
+ *  @return job handle for the removal, per user outcomes are in the job's succeeded, failed and errors
+ *  @discussion users are resolved in a few queries up front and deleted with bounded concurrency
+ */
+-(ODManagerJob*)removeUsers:(NSArray*)users
+           cleanMemberships:(BOOL)cleanMemberships
+                   progress:(void(^)(NSString* message,double progress))progress
+                      reply:(void(^)(NSError *error))reply;
 /**
- *  stops any add remove user list operation in progress.
+ *  stops every remove user list operation in progress.  Use -[ODManagerJob cancel] to stop a single removal.
  */
 -(void)cancelUserRemoval;
 
+#pragma mark - Reconcile
+///------------------------------
+/// @name Reconcile
+///------------------------------
+/**
+ *  Work out what would change to make the directory match a list, without changing anything
+ *
+ *  @param list           ODRecordList with the users and groups that should exist. Groups with members set have their membership managed.
+ *  @param deleteUnlisted whether users and groups missing from the list would be removed
+ *  @param error          populated should error occur
+ *
+ *  @return plan of creates, updates, deletes and membership changes
+ */
+-(ODReconcilePlan*)reconcilePlanForRecordList:(ODRecordList*)list
+                               deleteUnlisted:(BOOL)deleteUnlisted
+                                        error:(NSError**)error;
+
+/**
+ *  Asynchronously make the directory match a list
+ *
+ *  @param list           ODRecordList with the users and groups that should exist. Groups with members set have their membership managed.
+ *  @param deleteUnlisted whether users and groups missing from the list are removed
+ *  @param progress       block object to be excuted when a record is changed.  This block has no return value and takes two arguments, NSString and double
+ *  @param reply          A block object to be executed when the request operation finishes. This block has no return value and takes one argument: NSError.
+ *
+ *  @return job handle for the reconcile, nil if the node could not be authenticated
+ *  @discussion the directory is read once in bulk and only the differences are written, so cost follows what changed rather than directory size
+ */
+-(ODManagerJob*)reconcileRecordList:(ODRecordList*)list
+                     deleteUnlisted:(BOOL)deleteUnlisted
+                           progress:(void(^)(NSString* message,double progress))progress
+                              reply:(void(^)(NSError *error))reply;
+
 #pragma mark - Add Groups
 ///------------------------------
 /// @name Add Groups
@@ -287,7 +406,7 @@ extern NSString* kODMPresetRecord;
  *
  *  @return YES for success, NO on failure.
  */
--(BOOL)addGroup:(ODGroup*)group error:(NSError*)error;
+-(BOOL)addGroup:(ODGroup*)group error:(NSError**)error;
 
 /**
  *  Add a list of groups to the OpenDirectory Server
@@ -296,28 +415,60 @@ extern NSString* kODMPresetRecord;
  *  @param error populated should error occur
  *
  *  @return YES for success, NO on failure.
+ *  @discussion groups without a gid get the next free one, and each group's members are set in the same call that creates it
  */
--(BOOL)addGroups:(ODRecordList*)list error:(NSError*)error;
+-(BOOL)addGroups:(ODRecordList*)list error:(NSError**)error;
 
 /**
- *  Add a group to the OpenDirectory Server
+ *  Asynchronously add a list of groups
+ *
+ *  @param list     ODRecordList with the groups key set to an array of populated ODGroup objects
+ *  @param progress A block object to be executed when a group is added. This block has no return value and takes two arguments: NSString group name, double progress
+ *  @param reply    A block object to be executed when the request operation finishes. This block has no return value and takes one argument: NSError.
+ *
+ *  @return job that tracks the import and can cancel it
+ */
+-(ODManagerJob*)addListOfGroups:(ODRecordList*)list
+                       progress:(void (^)(NSString *group,double progress))progress
+                          reply:(void (^)(NSError *error))reply;
+
+/**
+ *  Remove a group from the OpenDirectory Server
  *
  *  @param group group record name
  *  @param error populated should error occur
  *
  *  @return YES for success, NO on failure.
  */
--(BOOL)removeGroup:(NSString*)group error:(NSError*)error;
+-(BOOL)removeGroup:(NSString*)group error:(NSError**)error;
 
 /**
- *  Add a group to the OpenDirectory Server
+ *  Remove a list of groups from the OpenDirectory Server
  *
  *  @param group Array of group record names
  *  @param error populated should error occur
  *
  *  @return YES for success, NO on failure.
  */
--(BOOL)removeGroups:(NSArray*)groups error:(NSError*)error;
+-(BOOL)removeGroups:(NSArray*)groups error:(NSError**)error;
+
+/**
+ *  Asynchronously remove a list of groups
+ *
+ *  @param groups   Array of group record names
+ *  @param progress A block object to be executed when a group is removed. This block has no return value and takes two arguments: NSString group name, double progress
+ *  @param reply    A block object to be executed when the request operation finishes. This block has no return value and takes one argument: NSError.
+ *
+ *  @return job that tracks the removal and can cancel it
+ */
+-(ODManagerJob*)removeGroups:(NSArray*)groups
+                    progress:(void (^)(NSString *group,double progress))progress
+                       reply:(void (^)(NSError *error))reply;
+
+/**
+ *  cancel every running group import and removal
+ */
+-(void)cancelGroupJobs;
 
 #pragma mark - Group Modification
 ///------------------------------
@@ -346,6 +497,18 @@ extern NSString* kODMPresetRecord;
  */
 -(BOOL)addUsers:(NSArray*)users toGroup:(NSString*)group error:(NSError**)error;
 
+/**
+ *  Add list of users to a group, logging each user added to a journal so the work can be resumed
+ *
+ *  @param users       Array of user record names
+ *  @param group       group record name
+ *  @param journalPath path of the journal file. It is created if needed; users it records as added to the group are skipped
+ *  @param error       populated should error occur
+ *
+ *  @return YES for success, NO on failure.
+ */
+-(BOOL)addUsers:(NSArray*)users toGroup:(NSString*)group journal:(NSString*)journalPath error:(NSError**)error;
+
 /**
  *  Removes a user from a group
  *
@@ -406,6 +569,44 @@ extern NSString* kODMPresetRecord;
 -(BOOL)resetPassword:(NSString*)oldPassword toPassword:(NSString *)newPassword user:(NSString*)user error:(NSError **)error;
 -(BOOL)resetPassword:(NSString*)oldPassword toPassword:(NSString *)newPassword user:(NSString*)user;
 
+/**
+ *  Asynchronously set new passwords for many users
+ *
+ *  @param passwords   dictionary of user record name -> new password
+ *  @param synchronize YES to synchronize each record after its password changes
+ *  @param progress    block object to be excuted when a user is done.  This block has no return value and takes two arguments, NSString and double
+ *  @param reply       A block object to be executed when the request operation finishes. This block has no return value and takes one argument: NSError.
+ *
+ *  @return job handle for the reset, per user outcomes are in the job's succeeded, failed and errors
+ *  @discussion users are looked up in batches and changed over several node handles at once.  Passwords are never logged or passed to the progress block.
+ */
+-(ODManagerJob*)resetPasswords:(NSDictionary*)passwords
+                   synchronize:(BOOL)synchronize
+                      progress:(void(^)(NSString* message,double progress))progress
+                         reply:(void(^)(NSError *error))reply;
+
+/**
+ *  Asynchronously set new passwords for many users, asking for each password only when the user is reached
+ *
+ *  @param users       user record names
+ *  @param generator   block that returns the new password for a user, or nil to skip the user.  It is called from several threads at once.
+ *  @param synchronize YES to synchronize each record after its password changes
+ *  @param progress    block object to be excuted when a user is done.  This block has no return value and takes two arguments, NSString and double
+ *  @param reply       A block object to be executed when the request operation finishes. This block has no return value and takes one argument: NSError.
+ *
+ *  @return job handle for the reset, nil if the node could not be authenticated
+ */
+-(ODManagerJob*)resetPasswordsForUsers:(NSArray*)users
+                             generator:(NSString*(^)(NSString* user))generator
+                           synchronize:(BOOL)synchronize
+                              progress:(void(^)(NSString* message,double progress))progress
+                                 reply:(void(^)(NSError *error))reply;
+
+/**
+ *  stops every bulk password reset in progress.  Use -[ODManagerJob cancel] to stop a single one.
+ */
+-(void)cancelPasswordResets;
+
 #pragma mark - Query
 ///------------------------------
 /// @name Query
@@ -453,6 +654,37 @@ extern NSString* kODMPresetRecord;
  */
 -(void)userListWithBlock:(void(^)(ODUser* user))reply;
 
+/**
+ *  Asynchronous query of users delivered in batches
+ *
+ *  @param batchSize  number of users per batch, 0 for the default
+ *  @param queue      queue the blocks are called on, nil for the main queue
+ *  @param batch      A block object to be executed for each batch. This block has no return value and takes one argument: NSArray of ODUser objects.
+ *  @param completion A block object to be executed once every batch has been handled. This block has no return value and takes one argument: NSError.
+ *
+ *  @return job for the query, cancel it to stop reading; completion is then called with a cancel error.
+ *  @discussion the query is paused while the batch block falls behind, so a slow consumer doesn't pile up records in memory
+ */
+-(ODManagerJob*)userListWithBatchSize:(NSUInteger)batchSize
+                       queue:(NSOperationQueue*)queue
+                       batch:(void(^)(NSArray *users))batch
+                  completion:(void(^)(NSError *error))completion;
+
+/**
+ *  Asynchronous query of groups delivered in batches
+ *
+ *  @param batchSize  number of groups per batch, 0 for the default
+ *  @param queue      queue the blocks are called on, nil for the main queue
+ *  @param batch      A block object to be executed for each batch. This block has no return value and takes one argument: NSArray of ODGroup objects.
+ *  @param completion A block object to be executed once every batch has been handled. This block has no return value and takes one argument: NSError.
+ *
+ *  @return job for the query, cancel it to stop reading; completion is then called with a cancel error.
+ */
+-(ODManagerJob*)groupListWithBatchSize:(NSUInteger)batchSize
+                                 queue:(NSOperationQueue*)queue
+                                 batch:(void(^)(NSArray *groups))batch
+                            completion:(void(^)(NSError *error))completion;
+
 /**
  *  Get a list of all the users in the directory
  *
@@ -476,6 +708,118 @@ extern NSString* kODMPresetRecord;
  */
 -(void)groupList:(void(^)(NSArray *allGroups))reply;
 
+/**
+ *  Records matching a query, filtered on the server where the node allows it
+ *
+ *  @param query query with record type, predicate, return attributes and limit
+ *  @param error populated should error occur
+ *
+ *  @return array of dictionaries of attribute -> array of values
+ *  @discussion e.g. users whose shell is /bin/null and primary group is 20:
+ *  [ODManagerQuery queryForType:kODRecordTypeUsers predicate:[ODManagerPredicate and:@[[ODManagerPredicate attribute:kODAttributeTypeUserShell equals:@"/bin/null"], [ODManagerPredicate attribute:kODAttributeTypePrimaryGroupID equals:@"20"]]]]
+ */
+-(NSArray*)recordsMatchingQuery:(ODManagerQuery*)query error:(NSError**)error;
+
+/**
+ *  Asynchronously run a query
+ *
+ *  @param query query with record type, predicate, return attributes and limit
+ *  @param reply A block object executed on the main queue when the query finishes. This block has no return value and takes two arguments: NSArray of attribute dictionaries and NSError.
+ */
+-(void)recordsMatchingQuery:(ODManagerQuery*)query reply:(void(^)(NSArray* records, NSError* error))reply;
+
+#pragma mark - Replicas
+///------------------------------
+/// @name Replicas
+///------------------------------
+/**
+ *  replica servers reads are spread over, nil when every read goes to the master
+ */
+@property (copy, readonly) NSArray *replicaServers;
+
+/**
+ *  Send reads to a set of replicas.  Each read goes to the replica with the fewest reads in flight; writes always go to directoryServer
+ *
+ *  @param servers replica addresses or node names, nil to send reads back to the master
+ *  @param error   populated should error occur
+ *
+ *  @return YES for success, NO if a replica could not be opened
+ */
+-(BOOL)setReplicaServers:(NSArray*)servers error:(NSError**)error;
+
+/**
+ *  Run a query on the master and every replica at once and merge the results by GUID
+ *
+ *  @param query query to run
+ *  @param error populated with the last error if no node answered
+ *
+ *  @return attribute dictionaries, one per record
+ */
+-(NSArray*)fanOutRecordsMatchingQuery:(ODManagerQuery*)query error:(NSError**)error;
+
+/**
+ *  Run a query on several nodes at once, such as those from avaliableLocalNodes, and merge the results by GUID
+ *
+ *  @param query     query to run
+ *  @param nodeNames node names to query
+ *  @param error     populated should error occur
+ *
+ *  @return attribute dictionaries, one per record
+ */
+-(NSArray*)recordsMatchingQuery:(ODManagerQuery*)query nodeNames:(NSArray*)nodeNames error:(NSError**)error;
+
+#pragma mark - Search
+///------------------------------
+/// @name Search
+///------------------------------
+/**
+ *  Asynchronous as-you-type search of users by record name, real name and email address
+ *
+ *  @param text     text typed so far
+ *  @param contains NO to match the start of a value or word, YES to match anywhere. Contains searches always go to the server
+ *  @param limit    maximum number of results, 0 for no limit
+ *  @param reply    A block object executed on the main queue with the results. This block has no return value and takes two arguments: NSArray of user record names and NSError.
+ *  @discussion a new user search makes any earlier one stale and its reply is never called.  Prefix searches are answered locally once loadSearchIndex: has been called.
+ */
+-(void)searchUsersMatching:(NSString*)text
+                  contains:(BOOL)contains
+                     limit:(NSUInteger)limit
+                     reply:(void(^)(NSArray* names, NSError* error))reply;
+
+/**
+ *  Asynchronous as-you-type search of groups by record name and real name
+ *
+ *  @param text     text typed so far
+ *  @param contains NO to match the start of a value or word, YES to match anywhere. Contains searches always go to the server
+ *  @param limit    maximum number of results, 0 for no limit
+ *  @param reply    A block object executed on the main queue with the results. This block has no return value and takes two arguments: NSArray of group record names and NSError.
+ *  @discussion a new group search makes any earlier one stale and its reply is never called.
+ */
+-(void)searchGroupsMatching:(NSString*)text
+                   contains:(BOOL)contains
+                      limit:(NSUInteger)limit
+                      reply:(void(^)(NSArray* names, NSError* error))reply;
+
+/**
+ *  stop every search in progress without calling its reply
+ */
+-(void)cancelSearches;
+
+/**
+ *  Read every user and group name once and answer prefix searches from a local index
+ *
+ *  @param error populated should error occur
+ *
+ *  @return YES for success, NO on failure.
+ *  @discussion users imported or removed through ODManager are kept current, call again to pick up changes made elsewhere
+ */
+-(BOOL)loadSearchIndex:(NSError**)error;
+
+/**
+ *  Send prefix searches back to the server
+ */
+-(void)clearSearchIndex;
+
 /**
  *  List of nodes the current computer is connected to
  *
@@ -491,8 +835,77 @@ extern NSString* kODMPresetRecord;
  *  @param error populated should error occur
  *
  *  @return YES for success, NO on failure.
+ *  @discussion answered locally, including nested groups, once loadMembershipCache: has been called.  Either way a user counts as a member through GroupMembership, GroupMembers (by GUID) or its PrimaryGroupID
  */
 -(BOOL)user:(NSString*)user isMemberOfGroup:(NSString *)group error:(NSError**)error;
 
+#pragma mark - Effective Membership
+///------------------------------
+/// @name Effective Membership
+///------------------------------
+/**
+ *  whether the membership cache has been loaded
+ */
+@property (readonly) BOOL membershipCacheLoaded;
+
+/**
+ *  Load every group's members and nested groups in one query and compute effective memberships
+ *
+ *  @param error populated should error occur
+ *
+ *  @return YES for success, NO on failure.
+ *  @discussion changes made with addUsers:toGroup: and removeUsers:fromGroup: keep the cache current, call again to pick up changes made elsewhere
+ */
+-(BOOL)loadMembershipCache:(NSError**)error;
+
+/**
+ *  Stop answering membership checks from the cache
+ */
+-(void)clearMembershipCache;
+
+/**
+ *  Every group a user belongs to directly or through nested groups
+ *
+ *  @param user user record name
+ *
+ *  @return set of group record names, nil if the cache is not loaded
+ */
+-(NSSet*)effectiveGroupsForUser:(NSString*)user;
+
+/**
+ *  Every user that belongs to a group directly or through nested groups
+ *
+ *  @param group group record name
+ *
+ *  @return set of user record names, nil if the cache is not loaded
+ */
+-(NSSet*)effectiveMembersOfGroup:(NSString*)group;
+
+#pragma mark - Export
+///------------------------------
+/// @name Export
+///------------------------------
+/**
+ *  Asynchronously write every record of the given types to a file
+ *
+ *  @param recordTypes record types to export, nil for users and groups.  A dsimport file takes a single type
+ *  @param path        file to write, replaced if it exists
+ *  @param format      JSON lines or dsimport
+ *  @param progress    A block object to be executed as each shard of the directory is finished. This block has no return value and takes two arguments: NSString shard, double progress
+ *  @param reply       A block object to be executed when the export finishes. This block has no return value and takes one argument: NSError.
+ *
+ *  @return job that tracks the export and can pause or cancel it
+ *  @discussion shards of the directory are queried in parallel across the server and any replicas, and records are streamed to the file so memory stays flat.  See ODManagerExporter for finer control
+ */
+-(ODManagerJob*)exportRecordTypes:(NSArray*)recordTypes
+                           toPath:(NSString*)path
+                           format:(ODMExportFormat)format
+                         progress:(void (^)(NSString *shard,double progress))progress
+                            reply:(void (^)(NSError *error))reply;
+
+/**
+ *  cancel every running export
+ */
+-(void)cancelExports;
 
 @end
@@ -28,16 +28,46 @@
 #import "ODManagerRecord.h"
 #import "ODManagerEditor.h"
 #import "ODManagerError.h"
+#import "ODManagerReconciler.h"
+#import "ODMembershipCache.h"
+#import "ODSearchIndex.h"
+#import "ODManagerJournal.h"
+#import "ODNodeRouter.h"
+#import "ODGIDAllocator.h"
 
 NSString* kODMUserRecord;
 NSString* kODMGroupRecord;
 NSString* kODMPresetRecord;
 
+/* node handles used by a bulk password reset, including the main one */
+static NSUInteger const kODMPasswordNodeHandles = 4;
+
+/* keepalive defaults, in seconds */
+static NSTimeInterval const kODMDefaultKeepaliveInterval = 60;
+static NSTimeInterval const kODMDefaultReauthenticateInterval = 900;
+
 @interface ODManager () <ODManagerDelegate> {
-    ODManagerNode* _nodeManager;
+    NSLock* _connectLock;
+    NSHashTable* _importJobs;
+    NSHashTable* _removalJobs;
+    NSHashTable* _passwordJobs;
+    NSHashTable* _groupJobs;
+    NSHashTable* _exportJobs;
+    NSOperationQueue* _searchQueue;
+    NSMutableDictionary* _searchOperations;
+    NSMutableDictionary* _gidAllocators; // node name -> ODGIDAllocator
+    dispatch_source_t _keepaliveTimer;
 }
 
-@property (readwrite, nonatomic) NSInteger status;
+@property (readwrite) NSInteger status;
+
+/* swapped as a whole, never modified in place */
+@property (strong) ODConnectionState* connection;
+
+/* replaced as a whole like the connection; readers take one reference and use it for the whole call */
+@property (strong) ODNodeRouter* router;
+@property (strong) ODMembershipCache* membershipCache;
+@property (strong) ODSearchIndex* searchIndex;
 @end
 
 @implementation ODManager {
@@ -59,6 +89,25 @@ NSString* kODMPresetRecord;
 }
 
 #pragma mark - Initializers
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        _importJobs = [NSHashTable weakObjectsHashTable];
+        _removalJobs = [NSHashTable weakObjectsHashTable];
+        _passwordJobs = [NSHashTable weakObjectsHashTable];
+        _groupJobs = [NSHashTable weakObjectsHashTable];
+        _exportJobs = [NSHashTable weakObjectsHashTable];
+        _searchQueue = [NSOperationQueue new];
+        _searchOperations = [NSMutableDictionary new];
+        _gidAllocators = [NSMutableDictionary new];
+        _connectLock = [NSLock new];
+        _connection = [ODConnectionState new];
+        _keepaliveInterval = kODMDefaultKeepaliveInterval;
+        _reauthenticateInterval = kODMDefaultReauthenticateInterval;
+    }
+    return self;
+}
 
 - (id)initWithDelegate:(id<ODManagerDelegate>)delegate
 {
@@ -98,6 +147,9 @@ NSString* kODMPresetRecord;
 
 - (void)dealloc
 {
+    if (_keepaliveTimer) {
+        dispatch_source_cancel(_keepaliveTimer);
+    }
     //    [self removeObserver:self forKeyPath:@"directoryDomain"];
     //    [self removeObserver:self forKeyPath:@"directoryServer"];
 }
@@ -121,12 +173,13 @@ NSString* kODMPresetRecord;
 
 - (void)queryWithDelegate:(id<ODManagerDelegate>)delegate type:(NSString*)type
 {
-    if (!_nodeManager.node) {
+    if (!self.connection.node) {
         if (![self getServerNode:nil]) {
             return;
         }
     }
-    ODManagerRecord* records = [[ODManagerRecord alloc] initWithNode:_nodeManager.node];
+    ODManagerRecord* records = [[ODManagerRecord alloc] initWithNode:self.connection.node];
+    records.stringPool = _queryStringPool;
     records.delegate = delegate;
     [records asyncQueryWithType:type];
 }
@@ -134,17 +187,64 @@ NSString* kODMPresetRecord;
 #pragma mark-- Async Reply with block
 - (void)userListWithBlock:(void (^)(ODUser* user))reply
 {
-    if (!_nodeManager.node) {
+    if (!self.connection.node) {
         if (![self getServerNode:nil]) {
             return;
         }
     }
 
-    ODManagerRecord* records = [[ODManagerRecord alloc] initWithNode:_nodeManager.node];
+    ODManagerRecord* records = [[ODManagerRecord alloc] initWithNode:self.connection.node];
+    records.stringPool = _queryStringPool;
     records.queryReplyBlock = reply;
     [records asyncQueryWithType:kODRecordTypeUsers];
 }
 
+#pragma mark-- Async Batches
+- (ODManagerJob*)userListWithBatchSize:(NSUInteger)batchSize queue:(NSOperationQueue*)queue batch:(void (^)(NSArray*))batch completion:(void (^)(NSError*))completion
+{
+    return [self queryType:kODRecordTypeUsers batchSize:batchSize queue:queue batch:batch completion:completion];
+}
+
+- (ODManagerJob*)groupListWithBatchSize:(NSUInteger)batchSize queue:(NSOperationQueue*)queue batch:(void (^)(NSArray*))batch completion:(void (^)(NSError*))completion
+{
+    return [self queryType:kODRecordTypeGroups batchSize:batchSize queue:queue batch:batch completion:completion];
+}
+
+- (ODManagerJob*)queryType:(NSString*)type batchSize:(NSUInteger)batchSize queue:(NSOperationQueue*)queue batch:(void (^)(NSArray*))batch completion:(void (^)(NSError*))completion
+{
+    ODManagerJob* job = [ODManagerJob new];
+    job.completionHandler = completion;
+
+    NSError* error;
+    ODConnectionState* connection = [self connectAuthenticating:NO error:&error];
+    if (!connection.node) {
+        [(queue ? queue : [NSOperationQueue mainQueue]) addOperationWithBlock:^{
+            [job finishWithError:error];
+        }];
+        return job;
+    }
+
+    /* the replica stays checked out until the last batch has been handled, a canceled query
+       still completes so it is always checked back in */
+    ODNodeRouter* router = self.router;
+    ODNode* replica = [router checkoutReadNode];
+    ODManagerRecord* records = [[ODManagerRecord alloc] initWithNode:replica ? replica : connection.node];
+    records.stringPool = _queryStringPool;
+    job.cancellationHandler = ^{
+        [records cancelQuery];
+    };
+    [job beginWithTotal:0];
+    [records asyncQueryWithType:type
+                      batchSize:batchSize
+                          queue:queue
+                          batch:batch
+                     completion:^(NSError* error) {
+                         [router checkinReadNode:replica];
+                         [job finishWithError:error];
+                     }];
+    return job;
+}
+
 #pragma mark-- With Reply Block
 - (void)userList:(void (^)(NSArray*))reply
 {
@@ -172,30 +272,274 @@ NSString* kODMPresetRecord;
 
 - (NSArray*)queryListType:(NSString*)type
 {
-    if (!_nodeManager.node) {
+    if (!self.connection.node) {
         if (![self getServerNode:nil]) {
             return nil;
         }
     }
-    ODManagerRecord* rg = [[ODManagerRecord alloc] initWithNode:_nodeManager.node];
-    return [rg listQueryWithType:type];
+    return [self readWithNode:^id(ODNode* node) {
+        ODManagerRecord* rg = [[ODManagerRecord alloc] initWithNode:node];
+        return [rg listQueryWithType:type];
+    }];
 }
 
 - (NSArray*)groupMembers:(NSString*)group
 {
-    if (!_nodeManager.node)
+    if (!self.connection.node)
         [self getServerNode:nil];
-    return [ODManagerRecord groupMembers:group node:_nodeManager.node];
+    return [self readWithNode:^id(ODNode* node) {
+        return [ODManagerRecord groupMembers:group node:node];
+    }];
+}
+
+#pragma mark-- Replicas
+- (id)readWithNode:(id (^)(ODNode* node))block
+{
+    ODNodeRouter* router = self.router;
+    if (router.replicaNodes.count) {
+        return [router read:block];
+    }
+    return block(self.connection.node);
+}
+
+- (BOOL)setReplicaServers:(NSArray*)servers error:(NSError* __autoreleasing*)error
+{
+    if (!servers.count) {
+        @synchronized(self)
+        {
+            self.router = nil;
+        }
+        return YES;
+    }
+    ODConnectionState* connection = [self connectAuthenticating:NO error:error];
+    if (!connection.node) {
+        return NO;
+    }
+
+    NSMutableArray* replicas = [NSMutableArray arrayWithCapacity:servers.count];
+    for (NSString* server in servers) {
+        ODNode* node = [connection.nodeManager openNodeNamed:server error:error];
+        if (!node) {
+            return NO;
+        }
+        [replicas addObject:node];
+    }
+    @synchronized(self)
+    {
+        self.router = [[ODNodeRouter alloc] initWithReplicas:replicas servers:servers];
+    }
+    return YES;
+}
+
+/* Open the router's replicas again on nodeManager's session.  A replica that can't be opened
+   keeps its old node so the next probe tries it again; the router is only swapped if nobody
+   has set new replica servers in the meantime. */
+- (void)reopenReplicasWithNodeManager:(ODManagerNode*)nodeManager
+{
+    ODNodeRouter* router = self.router;
+    NSArray* servers = router.servers;
+    if (!servers.count || !nodeManager.node) {
+        return;
+    }
+
+    NSMutableArray* replicas = [router.replicaNodes mutableCopy];
+    [servers enumerateObjectsUsingBlock:^(NSString* server, NSUInteger idx, BOOL* stop) {
+        ODNode* node = [nodeManager openNodeNamed:server error:nil];
+        if (node) {
+            replicas[idx] = node;
+        }
+    }];
+    @synchronized(self)
+    {
+        if (self.router == router) {
+            self.router = [[ODNodeRouter alloc] initWithReplicas:replicas servers:servers];
+        }
+    }
+}
+
+- (NSArray*)replicaServers
+{
+    return self.router.servers;
+}
+
+- (NSArray*)fanOutRecordsMatchingQuery:(ODManagerQuery*)query error:(NSError* __autoreleasing*)error
+{
+    ODConnectionState* connection = [self connectAuthenticating:NO error:error];
+    if (!connection.node) {
+        return nil;
+    }
+    NSMutableArray* nodes = [NSMutableArray arrayWithObject:connection.node];
+    NSArray* replicas = self.router.replicaNodes;
+    if (replicas) {
+        [nodes addObjectsFromArray:replicas];
+    }
+    return [ODNodeRouter fanOutQuery:query nodes:nodes error:error];
+}
+
+- (NSArray*)recordsMatchingQuery:(ODManagerQuery*)query nodeNames:(NSArray*)nodeNames error:(NSError* __autoreleasing*)error
+{
+    if (!self.connection.nodeManager && ![self getServerNode:error]) {
+        return nil;
+    }
+    NSMutableArray* nodes = [NSMutableArray arrayWithCapacity:nodeNames.count];
+    for (NSString* name in nodeNames) {
+        ODNode* node = [self.connection.nodeManager openNodeNamed:name error:error];
+        if (!node) {
+            return nil;
+        }
+        [nodes addObject:node];
+    }
+    return [ODNodeRouter fanOutQuery:query nodes:nodes error:error];
+}
+
+#pragma mark-- Predicate Query
+- (NSArray*)recordsMatchingQuery:(ODManagerQuery*)query error:(NSError* __autoreleasing*)error
+{
+    if (!self.connection.node && ![self getServerNode:error]) {
+        return nil;
+    }
+    __block NSError* err;
+    NSArray* records = [self readWithNode:^id(ODNode* node) {
+        return [query resultsWithNode:node error:&err];
+    }];
+    if (error)
+        *error = err;
+    return records;
+}
+
+- (void)recordsMatchingQuery:(ODManagerQuery*)query reply:(void (^)(NSArray*, NSError*))reply
+{
+    NSOperationQueue* queue = [NSOperationQueue new];
+    [queue addOperationWithBlock:^{
+        NSError* error;
+        NSArray* records = [self recordsMatchingQuery:query error:&error];
+        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+            reply(records, error);
+        }];
+    }];
+}
+
+#pragma mark-- Search
+- (void)searchUsersMatching:(NSString*)text contains:(BOOL)contains limit:(NSUInteger)limit reply:(void (^)(NSArray*, NSError*))reply
+{
+    [self searchType:kODRecordTypeUsers matching:text contains:contains limit:limit reply:reply];
+}
+
+- (void)searchGroupsMatching:(NSString*)text contains:(BOOL)contains limit:(NSUInteger)limit reply:(void (^)(NSArray*, NSError*))reply
+{
+    [self searchType:kODRecordTypeGroups matching:text contains:contains limit:limit reply:reply];
+}
+
+- (void)searchType:(NSString*)type matching:(NSString*)text contains:(BOOL)contains limit:(NSUInteger)limit reply:(void (^)(NSArray*, NSError*))reply
+{
+    ODSearchIndex* index = self.searchIndex;
+    NSBlockOperation* operation = [NSBlockOperation new];
+    __weak NSBlockOperation* weakOperation = operation;
+
+    [operation addExecutionBlock:^{
+        NSArray* names;
+        NSError* error;
+        if (index.isLoaded && !contains) {
+            names = [index namesOfType:type withPrefix:text limit:limit];
+        } else {
+            NSArray* attributes = [type isEqualToString:kODRecordTypeUsers]
+                                      ? @[ kODAttributeTypeRecordName, kODAttributeTypeFullName, kODAttributeTypeEMailAddress ]
+                                      : @[ kODAttributeTypeRecordName, kODAttributeTypeFullName ];
+            __block NSError* searchError;
+            names = [self readWithNode:^id(ODNode* node) {
+                return [ODManagerRecord recordNamesOfType:type
+                                                 matching:text
+                                                matchType:contains ? kODMatchContains : kODMatchBeginsWith
+                                               attributes:attributes
+                                                    limit:limit
+                                                     node:node
+                                                    error:&searchError];
+            }];
+            error = searchError;
+        }
+
+        /* a newer search of the same type makes this one stale, drop its results.  A released
+           operation can't be the current one, so a nil weakOperation is stale too */
+        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+            NSBlockOperation* strongOperation = weakOperation;
+            BOOL current;
+            @synchronized(_searchOperations)
+            {
+                current = strongOperation && _searchOperations[type] == strongOperation && !strongOperation.isCancelled;
+            }
+            if (current && reply) {
+                reply(names, error);
+            }
+        }];
+    }];
+
+    @synchronized(_searchOperations)
+    {
+        [_searchOperations[type] cancel];
+        _searchOperations[type] = operation;
+    }
+    [_searchQueue addOperation:operation];
+}
+
+- (void)indexUsers:(ODRecordList*)list succeeded:(NSArray*)succeeded
+{
+    ODSearchIndex* index = self.searchIndex;
+    if (!index.isLoaded || !succeeded.count) {
+        return;
+    }
+    NSSet* added = [NSSet setWithArray:succeeded];
+    NSMutableDictionary* valuesByName = [NSMutableDictionary dictionaryWithCapacity:added.count];
+    for (ODUser* user in list.users) {
+        if ([added containsObject:user.userName]) {
+            NSMutableArray* values = [NSMutableArray new];
+            if (user.firstName && user.lastName) {
+                [values addObject:[NSString stringWithFormat:@"%@ %@", user.firstName, user.lastName]];
+            }
+            if (user.emailDomain) {
+                [values addObject:[NSString stringWithFormat:@"%@@%@", user.userName, user.emailDomain]];
+            }
+            valuesByName[user.userName] = values;
+        }
+    }
+    /* the whole import goes in with one merge */
+    [index setValuesByName:valuesByName type:kODRecordTypeUsers];
+}
+
+- (void)cancelSearches
+{
+    @synchronized(_searchOperations)
+    {
+        [_searchOperations.allValues makeObjectsPerformSelector:@selector(cancel)];
+        [_searchOperations removeAllObjects];
+    }
+}
+
+- (BOOL)loadSearchIndex:(NSError* __autoreleasing*)error
+{
+    if (!self.connection.node && ![self getServerNode:error]) {
+        return NO;
+    }
+    ODSearchIndex* index = [[ODSearchIndex alloc] initWithNode:self.connection.node];
+    if (![index reload:error]) {
+        return NO;
+    }
+    self.searchIndex = index;
+    return YES;
+}
+
+- (void)clearSearchIndex
+{
+    self.searchIndex = nil;
 }
 
 - (NSArray*)avaliableLocalNodes
 {
-    if (!_nodeManager.node) {
+    if (!self.connection.node) {
         [self getServerNode:nil];
     }
 
-    if (_nodeManager.node) {
-        NSDictionary* dict = [_nodeManager.node nodeDetailsForKeys:nil error:nil];
+    if (self.connection.node) {
+        NSDictionary* dict = [self.connection.node nodeDetailsForKeys:nil error:nil];
         return dict[@"dsAttrTypeStandard:CSPSearchPath"];
     }
     return nil;
@@ -203,12 +547,91 @@ NSString* kODMPresetRecord;
 
 - (BOOL)user:(NSString*)user isMemberOfGroup:(NSString*)group error:(NSError* __autoreleasing*)error
 {
-    return [ODManagerRecord user:user isMemberOfGroup:group node:_nodeManager.node error:error];
+    ODMembershipCache* cache = self.membershipCache;
+    if (cache.isLoaded) {
+        return [cache user:user isMemberOfGroup:group];
+    }
+    return [ODManagerRecord user:user isMemberOfGroup:group node:self.connection.node error:error];
+}
+
+#pragma mark-- Effective Membership
+- (BOOL)loadMembershipCache:(NSError* __autoreleasing*)error
+{
+    if (!self.connection.node && ![self getServerNode:error]) {
+        return NO;
+    }
+    ODMembershipCache* cache = [[ODMembershipCache alloc] initWithNode:self.connection.node];
+    if (![cache reload:error]) {
+        return NO;
+    }
+    self.membershipCache = cache;
+    return YES;
+}
+
+- (void)clearMembershipCache
+{
+    self.membershipCache = nil;
+}
+
+- (BOOL)membershipCacheLoaded
+{
+    return self.membershipCache.isLoaded;
+}
+
+- (NSSet*)effectiveGroupsForUser:(NSString*)user
+{
+    return [self.membershipCache effectiveGroupsForUser:user];
+}
+
+- (NSSet*)effectiveMembersOfGroup:(NSString*)group
+{
+    return [self.membershipCache effectiveMembersOfGroup:group];
+}
+
+#pragma mark-- Export
+- (ODManagerJob*)exportRecordTypes:(NSArray*)recordTypes toPath:(NSString*)path format:(ODMExportFormat)format progress:(void (^)(NSString*, double))progress reply:(void (^)(NSError*))reply
+{
+    NSError* error;
+    ODConnectionState* connection = self.connection;
+    if (!connection.node) {
+        connection = [self connectAuthenticating:NO error:&error];
+    }
+    if (connection.node) {
+        NSMutableArray* nodes = [NSMutableArray arrayWithObject:connection.node];
+        NSArray* replicas = self.router.replicaNodes;
+        if (replicas) {
+            [nodes addObjectsFromArray:replicas];
+        }
+
+        ODManagerJob* job = [self newJobIn:_exportJobs progress:progress reply:reply];
+        ODManagerExporter* exporter = [[ODManagerExporter alloc] initWithNodes:nodes];
+        exporter.format = format;
+        exporter.job = job;
+        if (recordTypes) {
+            exporter.recordTypes = recordTypes;
+        }
+        /* enough queries in flight to keep every node busy */
+        exporter.maxConcurrentQueries = MAX(exporter.maxConcurrentQueries, 2 * nodes.count);
+
+        NSOperationQueue* exportQueue = [NSOperationQueue new];
+        [exportQueue addOperationWithBlock:^{
+            [exporter exportToPath:path error:nil];
+        }];
+        return job;
+    } else if (reply) {
+        reply(error);
+    }
+    return nil;
+}
+
+- (void)cancelExports
+{
+    [self cancelJobsIn:_exportJobs];
 }
 
 - (ODPreset*)settingsForPreset:(NSString*)preset
 {
-    return [ODManagerRecord settingsForPrest:preset node:_nodeManager.node];
+    return [ODManagerRecord settingsForPrest:preset node:self.connection.node];
 }
 
 #pragma mark - ODUser / ODGroup Modifiers
@@ -220,100 +643,190 @@ NSString* kODMPresetRecord;
 
 - (BOOL)addUser:(ODUser*)user withPreset:(NSString*)preset error:(NSError* __autoreleasing*)error
 {
-    if (_authenticated || [self authenticate:error] > 0) {
+    ODConnectionState* connection = [self authenticatedConnection:error];
+    if (connection) {
         ODRecordList* list = [ODRecordList new];
-        ODManagerEditor* editor = [[ODManagerEditor alloc] initWithNode:_nodeManager.node];
+        ODManagerEditor* editor = [[ODManagerEditor alloc] initWithNode:connection.node];
         list.users = @[ user ];
         return [editor addUsers:list withPreset:preset error:error];
     }
     return NO;
 }
 
-- (void)addListOfUsers:(ODRecordList*)list reply:(void (^)(NSError*))reply
+- (ODManagerJob*)addListOfUsers:(ODRecordList*)list reply:(void (^)(NSError*))reply
 {
-    [self addListOfUsers:list withPreset:nil reply:reply];
+    return [self addListOfUsers:list withPreset:nil reply:reply];
 }
 
-- (void)addListOfUsers:(ODRecordList*)list withPreset:(NSString*)preset reply:(void (^)(NSError*))reply
+- (ODManagerJob*)addListOfUsers:(ODRecordList*)list withPreset:(NSString*)preset reply:(void (^)(NSError*))reply
 {
-    NSError* error;
-    if (_authenticated || [self authenticate:&error] > 0) {
-        NSOperationQueue* userListQueue = [NSOperationQueue new];
-        [userListQueue addOperationWithBlock:^{
-            /* we use the singleton here so the import can get canceled */
-            ODManagerEditor *editor = [ODManagerEditor new];
-            editor.delegate=_delegate;
-            editor.errorReplyBlock=reply;
-            editor.progressUpdateBlock = _userAddedUpdateHandler;
-            editor.node=_nodeManager.node;
-            editor.continueImport = YES;
-            [editor addUsers:list withPreset:preset error:nil];
-        }];
-    } else {
-        reply(error);
-    }
+    return [self addListOfUsers:list withPreset:preset progress:_userAddedUpdateHandler reply:reply];
+}
+
+- (ODManagerJob*)addListOfUsers:(ODRecordList*)list progress:(void (^)(NSString*, double))progress reply:(void (^)(NSError*))reply
+{
+    return [self addListOfUsers:list withPreset:nil progress:progress reply:reply];
 }
 
-- (void)addListOfUsers:(ODRecordList*)list progress:(void (^)(NSString*, double))progress reply:(void (^)(NSError*))reply
+- (ODManagerJob*)addListOfUsers:(ODRecordList*)list withPreset:(NSString*)preset progress:(void (^)(NSString*, double))progress reply:(void (^)(NSError*))reply
 {
-    [self addListOfUsers:list withPreset:nil progress:progress reply:reply];
+    return [self addListOfUsers:list withPreset:preset journal:nil progress:progress reply:reply];
 }
 
-- (void)addListOfUsers:(ODRecordList*)list withPreset:(NSString*)preset progress:(void (^)(NSString*, double))progress reply:(void (^)(NSError*))reply
+- (ODManagerJob*)addListOfUsers:(ODRecordList*)list withPreset:(NSString*)preset journal:(NSString*)journalPath progress:(void (^)(NSString*, double))progress reply:(void (^)(NSError*))reply
 {
     NSError* error;
-    if (_authenticated || [self authenticate:&error] > 0) {
+    ODConnectionState* connection = [self authenticatedConnection:&error];
+    if (connection) {
+        ODManagerJob* job = [self newJobIn:_importJobs progress:progress reply:reply];
+        ODManagerEditor* editor = [[ODManagerEditor alloc] initWithNode:connection.node job:job];
+        editor.delegate = _delegate;
+
         NSOperationQueue* userListQueue = [NSOperationQueue new];
         [userListQueue addOperationWithBlock:^{
-            /* we use the singleton here so the import can get canceled */
-            ODManagerEditor *editor = [ODManagerEditor sharedEditor];
-            editor.progressUpdateBlock = progress;
-            editor.errorReplyBlock=reply;
-            editor.node=_nodeManager.node;
-            editor.continueImport = YES;
+            if (journalPath) {
+                NSError* journalError;
+                ODManagerJournal* journal = [[ODManagerJournal alloc] initWithPath:journalPath];
+                if (![journal open:&journalError]) {
+                    [job finishWithError:journalError];
+                    return;
+                }
+                editor.journal = journal;
+            }
             [editor addUsers:list withPreset:preset error:nil];
+            [editor.journal close];
+            [self indexUsers:list succeeded:job.succeeded];
         }];
-    } else {
+        return job;
+    } else if (reply) {
         reply(error);
     }
+    return nil;
 }
 
 - (void)cancelUserImport
 {
-    [[ODManagerEditor sharedEditor] setContinueImport:NO];
+    [self cancelJobsIn:_importJobs];
 }
 
 #pragma mark Remove Users
 - (BOOL)removeUser:(NSString*)user error:(NSError* __autoreleasing*)error
 {
-    ODRecord* record = [ODManagerRecord getUserRecord:user node:_nodeManager.node error:error];
+    ODRecord* record = [ODManagerRecord getUserRecord:user node:self.connection.node error:error];
     return [record deleteRecordAndReturnError:error];
 }
 
-- (void)removeUsers:(NSArray*)users reply:(void (^)(NSError* error))reply
+- (ODManagerJob*)removeUsers:(NSArray*)users reply:(void (^)(NSError* error))reply
+{
+    return [self removeUsers:users cleanMemberships:NO progress:nil reply:reply];
+}
+
+- (ODManagerJob*)removeUsers:(NSArray*)users cleanMemberships:(BOOL)cleanMemberships progress:(void (^)(NSString*, double))progress reply:(void (^)(NSError*))reply
 {
     NSError* error;
-    if (_authenticated || [self authenticate:&error] > 0) {
+    ODConnectionState* connection = [self authenticatedConnection:&error];
+    if (connection) {
+        ODManagerJob* job = [self newJobIn:_removalJobs progress:progress reply:reply];
+        ODManagerEditor* editor = [[ODManagerEditor alloc] initWithNode:connection.node job:job];
+        editor.delegate = _delegate;
+
         NSOperationQueue* userListQueue = [NSOperationQueue new];
         [userListQueue addOperationWithBlock:^{
-            NSError *replyError;
-            /* we use the singleton here so the import can get canceled */
-            ODManagerEditor *editor = [ODManagerEditor sharedEditor];
-            editor.node = _nodeManager.node;
-            editor.delegate=_delegate;
-            editor.errorReplyBlock=reply;
-            editor.cancelRemoval = NO;
-            [editor removeListOfUsers:users error:&replyError];
-            reply(replyError);
+            [editor removeListOfUsers:users cleanMemberships:cleanMemberships error:nil];
+            NSArray* removed = job.succeeded;
+            ODMembershipCache* cache = self.membershipCache;
+            for (NSString* user in removed) {
+                [cache removeUser:user];
+            }
+            [self.searchIndex removeNames:removed type:kODRecordTypeUsers];
         }];
-    } else {
+        return job;
+    } else if (reply) {
         reply(error);
     }
+    return nil;
 }
 
 - (void)cancelUserRemoval
 {
-    [[ODManagerEditor sharedEditor] setCancelRemoval:YES];
+    [self cancelJobsIn:_removalJobs];
+}
+
+#pragma mark Reconcile
+- (ODReconcilePlan*)reconcilePlanForRecordList:(ODRecordList*)list deleteUnlisted:(BOOL)deleteUnlisted error:(NSError* __autoreleasing*)error
+{
+    ODConnectionState* connection = [self authenticatedConnection:error];
+    if (connection) {
+        ODManagerReconciler* reconciler = [[ODManagerReconciler alloc] initWithNode:connection.node];
+        reconciler.deleteUnlistedUsers = deleteUnlisted;
+        reconciler.deleteUnlistedGroups = deleteUnlisted;
+        return [reconciler planForRecordList:list error:error];
+    }
+    return nil;
+}
+
+- (ODManagerJob*)reconcileRecordList:(ODRecordList*)list deleteUnlisted:(BOOL)deleteUnlisted progress:(void (^)(NSString*, double))progress reply:(void (^)(NSError*))reply
+{
+    NSError* error;
+    ODConnectionState* connection = [self authenticatedConnection:&error];
+    if (connection) {
+        ODManagerJob* job = [self newJobIn:_importJobs progress:progress reply:reply];
+        ODManagerReconciler* reconciler = [[ODManagerReconciler alloc] initWithNode:connection.node];
+        reconciler.deleteUnlistedUsers = deleteUnlisted;
+        reconciler.deleteUnlistedGroups = deleteUnlisted;
+        reconciler.gidAllocator = [self gidAllocatorForNode:connection.node];
+
+        NSOperationQueue* reconcileQueue = [NSOperationQueue new];
+        [reconcileQueue addOperationWithBlock:^{
+            NSError* planError;
+            ODReconcilePlan* plan = [reconciler planForRecordList:list error:&planError];
+            if (!plan) {
+                [job finishWithError:planError];
+                return;
+            }
+            /* the plan rewrites memberships in ways the cache can't follow one change at a time, so
+               checks go to the server while it runs and a loaded cache is read again afterwards */
+            BOOL cached = self.membershipCacheLoaded;
+            if (cached) {
+                [self clearMembershipCache];
+            }
+            [reconciler applyPlan:plan job:job error:nil];
+            if (cached) {
+                [self loadMembershipCache:nil];
+            }
+            /* renames, creates and deletes all land in the index, reading it again is one query per type */
+            if (self.searchIndex.isLoaded) {
+                [self loadSearchIndex:nil];
+            }
+        }];
+        return job;
+    } else if (reply) {
+        reply(error);
+    }
+    return nil;
+}
+
+#pragma mark Jobs
+- (ODManagerJob*)newJobIn:(NSHashTable*)jobs progress:(void (^)(NSString*, double))progress reply:(void (^)(NSError*))reply
+{
+    ODManagerJob* job = [ODManagerJob new];
+    job.progressHandler = progress;
+    job.completionHandler = reply;
+    @synchronized(jobs)
+    {
+        [jobs addObject:job];
+    }
+    return job;
+}
+
+- (void)cancelJobsIn:(NSHashTable*)jobs
+{
+    NSArray* active;
+    @synchronized(jobs)
+    {
+        active = [jobs allObjects];
+    }
+    [active makeObjectsPerformSelector:@selector(cancel)];
 }
 
 #pragma mark Add Users to Groups
@@ -324,10 +837,26 @@ NSString* kODMPresetRecord;
 
 - (BOOL)addUsers:(NSArray*)users toGroup:(NSString*)group error:(NSError* __autoreleasing*)error
 {
-    if (_authenticated || [self authenticate:error] > 0) {
-        ODManagerEditor* editor = [[ODManagerEditor alloc] initWithNode:_nodeManager.node];
+    return [self addUsers:users toGroup:group journal:nil error:error];
+}
+
+- (BOOL)addUsers:(NSArray*)users toGroup:(NSString*)group journal:(NSString*)journalPath error:(NSError* __autoreleasing*)error
+{
+    ODConnectionState* connection = [self authenticatedConnection:error];
+    if (connection) {
+        ODManagerEditor* editor = [[ODManagerEditor alloc] initWithNode:connection.node];
         editor.delegate = _delegate;
-        return [editor addUsers:users toGroup:group error:error];
+        if (journalPath) {
+            ODManagerJournal* journal = [[ODManagerJournal alloc] initWithPath:journalPath];
+            if (![journal open:error]) {
+                return NO;
+            }
+            editor.journal = journal;
+        }
+        BOOL rc = [editor addUsers:users toGroup:group error:error];
+        [editor.journal close];
+        [self.membershipCache addUsers:editor.job.succeeded toGroup:group];
+        return rc;
     }
     return NO;
 }
@@ -339,48 +868,178 @@ NSString* kODMPresetRecord;
 
 - (BOOL)removeUsers:(NSArray*)users fromGroup:(NSString*)group error:(NSError* __autoreleasing*)error
 {
-    if (_authenticated || [self authenticate:error] > 0) {
-        ODManagerEditor* editor = [[ODManagerEditor alloc] initWithNode:_nodeManager.node];
-        return [editor removeUsers:users fromGroup:group error:error];
+    ODConnectionState* connection = [self authenticatedConnection:error];
+    if (connection) {
+        ODManagerEditor* editor = [[ODManagerEditor alloc] initWithNode:connection.node];
+        BOOL rc = [editor removeUsers:users fromGroup:group error:error];
+        [self.membershipCache removeUsers:editor.job.succeeded fromGroup:group];
+        return rc;
     }
     return NO;
 }
 
 - (BOOL)removeAllUsersFromGroup:(NSString*)group error:(NSError* __autoreleasing*)error
 {
-    if (_authenticated || [self authenticate:error] > 0) {
-        ODManagerEditor* editor = [[ODManagerEditor alloc] initWithNode:_nodeManager.node];
-        ODRecord* record = [ODManagerRecord getGroupRecord:group node:_nodeManager.node error:error];
+    ODConnectionState* connection = [self authenticatedConnection:error];
+    if (connection) {
+        ODManagerEditor* editor = [[ODManagerEditor alloc] initWithNode:connection.node];
+        ODRecord* record = [ODManagerRecord getGroupRecord:group node:connection.node error:error];
         NSDictionary* attributes = [record recordDetailsForAttributes:@[ kODAttributeTypeGroupMembers ] error:nil];
         NSArray* users = attributes[@"dsAttrTypeStandard:GroupMembers"];
-        if (users.count)
-            return [editor removeUsers:users fromGroup:group error:error];
-        else
+        if (!users.count)
             return YES;
+        BOOL rc = [editor removeUsers:users fromGroup:group error:error];
+        /* the members are GUIDs here, so a partial removal can't be applied to the cache by name */
+        if (rc) {
+            [self.membershipCache removeAllUsersFromGroup:group];
+        } else {
+            [self clearMembershipCache];
+        }
+        return rc;
     }
     return NO;
 }
 
 #pragma mark Add Groups
-- (BOOL)addGroup:(ODGroup*)group error:(NSError*)error
+- (BOOL)addGroup:(ODGroup*)group error:(NSError* __autoreleasing*)error
 {
-    return NO;
+    ODRecordList* list = [ODRecordList new];
+    list.groups = @[ group ];
+    return [self addGroups:list error:error];
 }
 
-- (BOOL)addGroups:(ODRecordList*)list error:(NSError*)error
+- (BOOL)addGroups:(ODRecordList*)list error:(NSError* __autoreleasing*)error
 {
+    ODConnectionState* connection = [self authenticatedConnection:error];
+    if (connection) {
+        ODManagerEditor* editor = [[ODManagerEditor alloc] initWithNode:connection.node];
+        editor.gidAllocator = [self gidAllocatorForNode:connection.node];
+        BOOL rc = [editor addGroups:list error:error];
+        [self groupsAdded:list editor:editor];
+        return rc;
+    }
     return NO;
 }
-- (BOOL)removeGroup:(NSString*)group error:(NSError*)error
+
+- (ODManagerJob*)addListOfGroups:(ODRecordList*)list progress:(void (^)(NSString*, double))progress reply:(void (^)(NSError*))reply
 {
-    return NO;
+    NSError* error;
+    ODConnectionState* connection = [self authenticatedConnection:&error];
+    if (connection) {
+        ODManagerJob* job = [self newJobIn:_groupJobs progress:progress reply:reply];
+        ODManagerEditor* editor = [[ODManagerEditor alloc] initWithNode:connection.node job:job];
+        editor.delegate = _delegate;
+        editor.gidAllocator = [self gidAllocatorForNode:connection.node];
+
+        NSOperationQueue* groupListQueue = [NSOperationQueue new];
+        [groupListQueue addOperationWithBlock:^{
+            [editor addGroups:list error:nil];
+            [self groupsAdded:list editor:editor];
+        }];
+        return job;
+    } else if (reply) {
+        reply(error);
+    }
+    return nil;
+}
+
+- (BOOL)removeGroup:(NSString*)group error:(NSError* __autoreleasing*)error
+{
+    return [self removeGroups:@[ group ] error:error];
 }
 
-- (BOOL)removeGroups:(NSArray*)groups error:(NSError*)error
+- (BOOL)removeGroups:(NSArray*)groups error:(NSError* __autoreleasing*)error
 {
+    ODConnectionState* connection = [self authenticatedConnection:error];
+    if (connection) {
+        ODManagerEditor* editor = [[ODManagerEditor alloc] initWithNode:connection.node];
+        editor.gidAllocator = [self gidAllocatorForNode:connection.node];
+        BOOL rc = [editor removeGroups:groups error:error];
+        [self groupsRemoved:editor.job.succeeded];
+        return rc;
+    }
     return NO;
 }
 
+- (ODManagerJob*)removeGroups:(NSArray*)groups progress:(void (^)(NSString*, double))progress reply:(void (^)(NSError*))reply
+{
+    NSError* error;
+    ODConnectionState* connection = [self authenticatedConnection:&error];
+    if (connection) {
+        ODManagerJob* job = [self newJobIn:_groupJobs progress:progress reply:reply];
+        ODManagerEditor* editor = [[ODManagerEditor alloc] initWithNode:connection.node job:job];
+        editor.delegate = _delegate;
+        editor.gidAllocator = [self gidAllocatorForNode:connection.node];
+
+        NSOperationQueue* groupListQueue = [NSOperationQueue new];
+        [groupListQueue addOperationWithBlock:^{
+            [editor removeGroups:groups error:nil];
+            [self groupsRemoved:job.succeeded];
+        }];
+        return job;
+    } else if (reply) {
+        reply(error);
+    }
+    return nil;
+}
+
+- (void)cancelGroupJobs
+{
+    [self cancelJobsIn:_groupJobs];
+}
+
+/* One allocator per node, shared by every editor so concurrent creates never hand out the same gid.
+   Editors read it from the node the first time they need it; a new connection marks it to be read
+   again rather than replacing it, so IDs already handed out stay claimed. */
+- (ODGIDAllocator*)gidAllocatorForNode:(ODNode*)node
+{
+    NSString* name = node.nodeName ? node.nodeName : @"";
+    @synchronized(_gidAllocators)
+    {
+        ODGIDAllocator* allocator = _gidAllocators[name];
+        if (!allocator) {
+            allocator = [ODGIDAllocator new];
+            _gidAllocators[name] = allocator;
+        }
+        return allocator;
+    }
+}
+
+/* keep the membership cache and search index in step with groups created here.  Only the members the editor
+   actually wrote go in the cache, names with no user record were skipped */
+- (void)groupsAdded:(ODRecordList*)list editor:(ODManagerEditor*)editor
+{
+    NSDictionary* addedMembers = editor.addedMembers;
+    if (!addedMembers.count) {
+        return;
+    }
+    NSMutableDictionary* valuesByName = [NSMutableDictionary dictionaryWithCapacity:addedMembers.count];
+    ODMembershipCache* cache = self.membershipCache;
+    for (ODGroup* group in list.groups) {
+        NSArray* members = addedMembers[group.groupName];
+        if (!members) {
+            continue;
+        }
+        if (members.count) {
+            [cache addUsers:members toGroup:group.groupName];
+        }
+        valuesByName[group.groupName] = group.fullName ? @[ group.fullName ] : @[];
+    }
+    ODSearchIndex* index = self.searchIndex;
+    if (index.isLoaded) {
+        [index setValuesByName:valuesByName type:kODRecordTypeGroups];
+    }
+}
+
+- (void)groupsRemoved:(NSArray*)succeeded
+{
+    ODMembershipCache* cache = self.membershipCache;
+    for (NSString* group in succeeded) {
+        [cache removeGroup:group];
+    }
+    [self.searchIndex removeNames:succeeded type:kODRecordTypeGroups];
+}
+
 #pragma mark - Passwords
 
 - (BOOL)resetPassword:(NSString*)oldPassword toPassword:(NSString*)newPassword user:(NSString*)user
@@ -390,12 +1049,68 @@ NSString* kODMPresetRecord;
 
 - (BOOL)resetPassword:(NSString*)oldPassword toPassword:(NSString*)newPassword user:(NSString*)user error:(NSError* __autoreleasing*)error
 {
-    ODManagerEditor* editor = [[ODManagerEditor alloc] initWithNode:_nodeManager.node
-                                                             status:_authenticated];
+    ODConnectionState* connection = self.connection;
+    ODManagerEditor* editor = [[ODManagerEditor alloc] initWithNode:connection.node
+                                                             status:connection.authenticated];
 
     return [editor changePassword:oldPassword to:newPassword user:user error:error];
 }
 
+- (ODManagerJob*)resetPasswords:(NSDictionary*)passwords synchronize:(BOOL)synchronize progress:(void (^)(NSString*, double))progress reply:(void (^)(NSError*))reply
+{
+    return [self resetPasswordsForUsers:passwords.allKeys
+                              generator:^NSString*(NSString* user) { return passwords[user]; }
+                            synchronize:synchronize
+                               progress:progress
+                                  reply:reply];
+}
+
+- (ODManagerJob*)resetPasswordsForUsers:(NSArray*)users generator:(NSString* (^)(NSString*))generator synchronize:(BOOL)synchronize progress:(void (^)(NSString*, double))progress reply:(void (^)(NSError*))reply
+{
+    NSError* error;
+    ODConnectionState* connection = [self authenticatedConnection:&error];
+    if (connection) {
+        ODManagerJob* job = [self newJobIn:_passwordJobs progress:progress reply:reply];
+        ODManagerEditor* editor = [[ODManagerEditor alloc] initWithNode:connection.node job:job];
+        editor.delegate = _delegate;
+        editor.authenticated = YES;
+
+        ODManagerNode* nodeManager = connection.nodeManager;
+        NSString* diradmin;
+        NSString* diradminPassword;
+        @synchronized(self)
+        {
+            diradmin = _diradmin;
+            diradminPassword = _diradminPassword;
+        }
+
+        NSOperationQueue* passwordQueue = [NSOperationQueue new];
+        [passwordQueue addOperationWithBlock:^{
+            /* extra handles are a bonus, the change runs on the main node if none can be opened */
+            NSMutableArray* handles = [NSMutableArray new];
+            for (NSUInteger i = 1; i < kODMPasswordNodeHandles; i++) {
+                ODNode* handle = [nodeManager openNodeHandleWithUser:diradmin password:diradminPassword error:nil];
+                if (!handle) {
+                    break;
+                }
+                [handles addObject:handle];
+            }
+            editor.nodeHandles = handles;
+            editor.maxConcurrentOperations = kODMPasswordNodeHandles;
+            [editor changePasswordsForUsers:users generator:generator synchronize:synchronize error:nil];
+        }];
+        return job;
+    } else if (reply) {
+        reply(error);
+    }
+    return nil;
+}
+
+- (void)cancelPasswordResets
+{
+    [self cancelJobsIn:_passwordJobs];
+}
+
 #pragma mark - Node
 - (BOOL)refreshNode
 {
@@ -404,68 +1119,260 @@ NSString* kODMPresetRecord;
 
 - (BOOL)refreshNode:(NSError* __autoreleasing*)error
 {
-    BOOL rc = [self getServerNode:error];
-    if (rc && _diradmin && _diradminPassword) {
-        [self authenticate:error];
-    };
-    return rc;
+    BOOL credentials;
+    @synchronized(self)
+    {
+        credentials = _diradmin && _diradminPassword;
+    }
+    [self invalidateConnection];
+    ODConnectionState* connection = [self connectAuthenticating:credentials error:error];
+    return connection.node != nil;
 }
 
 - (BOOL)getServerNode:(NSError* __autoreleasing*)error
 {
-    if (_nodeManager.status > 0) {
-        return YES;
+    return [self connectAuthenticating:NO error:error].node != nil;
+}
+
+- (ODManagerNodeStatus)authenticate
+{
+    return [self authenticate:nil];
+}
+
+- (ODManagerNodeStatus)authenticate:(NSError* __autoreleasing*)error
+{
+    ODConnectionState* connection = [self connectAuthenticating:YES error:error];
+    if (!connection.node) {
+        return kODMNodeNotSet;
     }
+    return connection.status;
+}
 
-    _nodeManager = [[ODManagerNode alloc] initWithServer:_directoryServer domain:_directoryDomain];
+- (BOOL)authCheck:(NSError* __autoreleasing*)error
+{
+    return [self authenticatedConnection:error] != nil;
+}
 
-    if (_delegate)
-        _nodeManager.delegate = _delegate;
-    else
-        _nodeManager.delegate = self;
+- (BOOL)authenticated
+{
+    return self.connection.authenticated;
+}
 
-    [_nodeManager getServerNode:_diradmin pass:_diradminPassword error:error];
+#pragma mark - Connection
+- (ODConnectionState*)authenticatedConnection:(NSError* __autoreleasing*)error
+{
+    ODConnectionState* connection = self.connection;
+    if (connection.authenticated) {
+        return connection;
+    }
+    connection = [self connectAuthenticating:YES error:error];
+    return connection.authenticated ? connection : nil;
+}
 
-    if (_nodeManager.node) {
-        return YES;
+/* Readers never lock, they take whatever snapshot is current.  Only a caller that needs a
+   new connection takes _connectLock; anyone who queued behind it gets the snapshot that attempt
+   published, failed or not, so a server that is down costs one timeout rather than one per caller. */
+- (ODConnectionState*)connectAuthenticating:(BOOL)authenticate error:(NSError* __autoreleasing*)error
+{
+    ODConnectionState* seen = self.connection;
+    if (seen.node && (!authenticate || seen.authenticated)) {
+        return seen;
     }
-    return NO;
+
+    [_connectLock lock];
+    ODConnectionState* current = self.connection;
+    if (current.generation != seen.generation) {
+        if (current.node && (!authenticate || current.authenticated)) {
+            [_connectLock unlock];
+            return current;
+        }
+        if (current.error) {
+            [_connectLock unlock];
+            if (error)
+                *error = current.error;
+            return current;
+        }
+    }
+    ODConnectionState* connection = [self publishConnectionFrom:current fresh:NO authenticate:authenticate error:error];
+    [_connectLock unlock];
+    return connection;
 }
 
-- (ODManagerNodeStatus)authenticate
+/* Build a new connection to take the place of stale, unless someone already has.
+   The old snapshot stays usable by anyone holding it until the new one is published. */
+- (ODConnectionState*)replaceConnection:(ODConnectionState*)stale authenticate:(BOOL)authenticate error:(NSError* __autoreleasing*)error
 {
-    return [self authenticate:nil];
+    [_connectLock lock];
+    ODConnectionState* current = self.connection;
+    if (current != stale) {
+        [_connectLock unlock];
+        if (current.error && error)
+            *error = current.error;
+        return current;
+    }
+    ODConnectionState* connection = [self publishConnectionFrom:current fresh:YES authenticate:authenticate error:error];
+    [_connectLock unlock];
+    return connection;
 }
 
-- (ODManagerNodeStatus)authenticate:(NSError* __autoreleasing*)error
+/* caller holds _connectLock.  Always publishes, a failed attempt carries its error so the
+   callers queued behind it can return it.  A node manager that has been published is never
+   authenticated again; credentials go on a new handle that is published in its place. */
+- (ODConnectionState*)publishConnectionFrom:(ODConnectionState*)current fresh:(BOOL)fresh authenticate:(BOOL)authenticate error:(NSError* __autoreleasing*)error
 {
-    if (!_nodeManager.node && ![self getServerNode:error]) {
-        return kODMNodeNotSet;
+    NSString* diradmin;
+    NSString* diradminPassword;
+    NSString* directoryServer;
+    ODMDirectoryDomains directoryDomain;
+    @synchronized(self)
+    {
+        diradmin = _diradmin;
+        diradminPassword = _diradminPassword;
+        directoryServer = _directoryServer;
+        directoryDomain = _directoryDomain;
     }
 
-    if (_nodeManager.domain == kODMProxyDirectoryServer) {
-        _authenticated = _nodeManager.status > 0 ? YES : NO;
-        return _nodeManager.status;
+    NSError* err;
+    ODManagerNode* nodeManager = fresh ? nil : current.nodeManager;
+    if (!nodeManager.node) {
+        nodeManager = [[ODManagerNode alloc] initWithServer:directoryServer domain:directoryDomain];
+        nodeManager.delegate = _delegate ? _delegate : self;
+        [nodeManager getServerNode:diradmin pass:diradminPassword error:&err];
     }
 
-    if (_delegate)
-        _nodeManager.delegate = _delegate;
-    else
-        _nodeManager.delegate = self;
+    BOOL authenticated = current.authenticated && nodeManager == current.nodeManager;
+    if (authenticate && nodeManager.node && !authenticated) {
+        if (nodeManager.domain == kODMProxyDirectoryServer) {
+            authenticated = nodeManager.status > 0;
+        } else {
+            ODManagerNode* candidate = nodeManager == current.nodeManager ? [nodeManager nodeManagerWithNewHandle:&err] : nodeManager;
+            if (candidate) {
+                candidate.delegate = _delegate ? _delegate : self;
+                authenticated = [candidate authenticateWithUser:diradmin password:diradminPassword error:&err] > 0;
+                nodeManager = candidate;
+            }
+        }
+    }
 
-    OSStatus status = [_nodeManager authenticateWithUser:_diradmin password:_diradminPassword error:error];
+    BOOL failed = !nodeManager.node || (authenticate && !authenticated);
+    if (failed && !err) {
+        [ODManagerError errorWithCode:nodeManager.node ? kODMerrInvakidCredentials : kODMerrCouldNotConnectToNode error:&err];
+    }
+    if (failed && error)
+        *error = err;
+
+    ODConnectionState* connection = [[ODConnectionState alloc] initWithNodeManager:nodeManager
+                                                                     authenticated:authenticated
+                                                                        generation:current.generation + 1
+                                                                             error:failed ? err : nil];
+    self.connection = connection;
+    if (nodeManager != current.nodeManager) {
+        @synchronized(_gidAllocators)
+        {
+            [_gidAllocators.allValues makeObjectsPerformSelector:@selector(setNeedsLoad)];
+        }
+        /* replicas were opened on the old session, move them to the new one */
+        if (nodeManager.session != current.nodeManager.session) {
+            [self reopenReplicasWithNodeManager:nodeManager];
+        }
+    }
+    return connection;
+}
 
-    _authenticated = status > 0 ? YES : NO;
+/* the next call builds a new connection */
+- (void)invalidateConnection
+{
+    [_connectLock lock];
+    self.connection = [[ODConnectionState alloc] initWithNodeManager:nil
+                                                       authenticated:NO
+                                                          generation:self.connection.generation + 1];
+    [_connectLock unlock];
+}
 
-    return status;
+#pragma mark - Keepalive
+- (void)startKeepalive
+{
+    @synchronized(self)
+    {
+        if (_keepaliveTimer) {
+            return;
+        }
+        uint64_t interval = (_keepaliveInterval > 0 ? _keepaliveInterval : kODMDefaultKeepaliveInterval) * NSEC_PER_SEC;
+        _keepaliveTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0));
+        dispatch_source_set_timer(_keepaliveTimer, dispatch_time(DISPATCH_TIME_NOW, interval), interval, interval / 10);
+
+        __weak ODManager* weakSelf = self;
+        dispatch_source_set_event_handler(_keepaliveTimer, ^{
+            [weakSelf keepalive];
+        });
+        dispatch_resume(_keepaliveTimer);
+    }
+
+    /* warm the connection now rather than on the first tick */
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), ^{
+        [self keepalive];
+    });
 }
 
-- (BOOL)authCheck:(NSError* __autoreleasing*)error
+- (void)stopKeepalive
 {
-    if (!_authenticated || ![self authenticate:error]) {
-        return NO;
+    @synchronized(self)
+    {
+        if (_keepaliveTimer) {
+            dispatch_source_cancel(_keepaliveTimer);
+            _keepaliveTimer = nil;
+        }
+    }
+}
+
+- (BOOL)isKeepaliveRunning
+{
+    @synchronized(self)
+    {
+        return _keepaliveTimer != nil;
+    }
+}
+
+/* Runs off the timer, one tick at a time.  Every repair goes through the same single-flight
+   paths as user calls, so a tick that races a caller's reconnect just picks up its result. */
+- (void)keepalive
+{
+    BOOL credentials;
+    @synchronized(self)
+    {
+        credentials = _diradmin && _diradminPassword;
+    }
+
+    ODConnectionState* connection = self.connection;
+    if (!connection.node) {
+        [self connectAuthenticating:credentials error:nil];
+        return;
+    }
+
+    /* probe the node for one small key, a connection that can't answer is rebuilt before anyone
+       else finds out; rebuilding it reopens the replicas too */
+    NSArray* probe = @[ kODAttributeTypeNodePath ];
+    if (![connection.node nodeDetailsForKeys:probe error:nil]) {
+        [self replaceConnection:connection authenticate:credentials error:nil];
+        return;
+    }
+    for (ODNode* replica in self.router.replicaNodes) {
+        if (![replica nodeDetailsForKeys:probe error:nil]) {
+            [self reopenReplicasWithNodeManager:connection.nodeManager];
+            break;
+        }
+    }
+
+    if (!credentials) {
+        return;
+    }
+
+    if (!connection.authenticated) {
+        [self connectAuthenticating:YES error:nil];
+    } else if (_reauthenticateInterval > 0 &&
+               [NSDate timeIntervalSinceReferenceDate] - connection.timestamp >= _reauthenticateInterval) {
+        [self replaceConnection:connection authenticate:YES error:nil];
     }
-    return YES;
 }
 
 #pragma mark - Observers;
@@ -479,23 +1386,37 @@ NSString* kODMPresetRecord;
 #pragma mark - Setters/Getters
 - (void)setDiradmin:(NSString*)diradmin
 {
-    _diradmin = diradmin;
+    @synchronized(self)
+    {
+        _diradmin = [diradmin copy];
+    }
 }
 
 - (void)setDiradminPassword:(NSString*)diradminPassword
 {
-    _diradminPassword = diradminPassword;
+    @synchronized(self)
+    {
+        _diradminPassword = [diradminPassword copy];
+    }
 }
 
 - (void)setDirectoryServer:(NSString*)directoryServer
 {
-    _directoryServer = directoryServer;
+    @synchronized(self)
+    {
+        _directoryServer = [directoryServer copy];
+    }
+    [self invalidateConnection];
     [self getServerNode:nil];
 }
 
 - (void)setDirectoryDomain:(ODMDirectoryDomains)directoryDomain
 {
-    _directoryDomain = directoryDomain;
+    @synchronized(self)
+    {
+        _directoryDomain = directoryDomain;
+    }
+    [self invalidateConnection];
     [self getServerNode:nil];
 }
 
@@ -26,35 +26,113 @@
 
 #import <Foundation/Foundation.h>
 #import "ODManager.h"
-@class ODNode;
+#import "ODManagerJob.h"
+@class ODNode, ODManagerJournal, ODGIDAllocator;
 
 @interface ODManagerEditor : NSObject
 
-@property (weak) ODNode *node;
+@property (strong) ODNode *node;
 @property (weak) id<ODManagerDelegate>delegate;
-@property (weak,nonatomic) void(^errorReplyBlock)(NSError *error);
-@property (weak,nonatomic) void(^progressUpdateBlock)(NSString *message,double progress);
+
+/**
+ *  job that tracks progress, cancelation and results of the bulk operations run by this editor.
+ *  @discussion each editor gets its own job, so concurrent imports and removals don't share state.
+ */
+@property (strong) ODManagerJob *job;
+
+/* these forward to the job, kept for existing callers */
+@property (copy,nonatomic) void(^errorReplyBlock)(NSError *error);
+@property (copy,nonatomic) void(^progressUpdateBlock)(NSString *message,double progress);
 
 @property BOOL authenticated;
-@property BOOL continueImport;
-@property BOOL cancelRemoval;
+
+/**
+ *  number of records written to the node at once by the bulk methods. Defaults to 4
+ */
+@property NSUInteger maxConcurrentOperations;
+
+/**
+ *  extra authenticated handles to the same node, bulk password changes spread their batches across these and node
+ */
+@property (copy) NSArray *nodeHandles;
+
+/**
+ *  open journal that the bulk methods log finished stages to, and consult to skip work done by an earlier run
+ */
+@property (strong) ODManagerJournal *journal;
+
+/**
+ *  group IDs new groups are given from.  ODManager shares one per node between its editors so concurrent creates never pick the same ID; a new one is made when nil.  Read from the node by the first group create that needs it
+ */
+@property (strong) ODGIDAllocator *gidAllocator;
+
+/**
+ *  group name -> user names written into the group when addGroups: created it.  Members that were skipped because no such user exists are not included
+ */
+@property (copy, readonly) NSDictionary *addedMembers;
+
+@property (nonatomic) BOOL continueImport;
+@property (nonatomic) BOOL cancelRemoval;
 
 +(ODManagerEditor*)sharedEditor;
 
 -(id)initWithNode:(ODNode*)node;
 -(id)initWithNode:(ODNode*)node status:(BOOL)status;
+-(id)initWithNode:(ODNode*)node job:(ODManagerJob*)job;
 
 -(BOOL)addUsers:(ODRecordList *)list error:(NSError**)error;
 -(BOOL)addUsers:(ODRecordList *)list withPreset:(NSString*)preset error:(NSError**)error;
 
 -(BOOL)removeListOfUsers:(NSArray*)users error:(NSError**)error;
 
+/**
+ *  Resolves every user up front, deletes them with bounded concurrency and, when cleanMemberships is set,
+ *  removes them from every group they belonged to with one write per affected group.
+ *  @discussion per user outcomes are on the editor's job
+ */
+-(BOOL)removeListOfUsers:(NSArray*)users cleanMemberships:(BOOL)cleanMemberships error:(NSError**)error;
+
+/**
+ *  Drops removed users from the GroupMembership and GroupMembers of every group that lists them, one write per affected group.
+ *  @discussion removed maps user name -> GUID, an empty string when the GUID isn't known.  The groups must have been read with both membership attributes
+ */
++(BOOL)removeMembers:(NSDictionary*)removed fromGroupRecords:(NSArray*)groups queue:(NSOperationQueue*)queue error:(NSError**)error;
+
 -(BOOL)addGroup:(ODGroup*)group error:(NSError**)error;
+
+/**
+ *  Creates the list's groups with bounded concurrency.  Each group is created with its PrimaryGroupID, GroupMembership and GroupMembers in the one call.
+ *  @discussion groups without a gid get the next free one from gidAllocator, which is read from the node again at the start of every call so groups added by other tools are seen.  A requested gid must be a whole positive number no other group uses; one outside the allocator's range is looked up on the node.  Groups that already exist and members that don't are skipped.  Per group outcomes are on the editor's job
+ */
+-(BOOL)addGroups:(ODRecordList *)list error:(NSError**)error;
+
 -(BOOL)removeGroup:(NSString*)group error:(NSError**)error;
 
+/**
+ *  Resolves every group in one query and deletes them with bounded concurrency, returning their gids to gidAllocator
+ */
+-(BOOL)removeGroups:(NSArray*)groups error:(NSError**)error;
+
 -(BOOL)addUsers:(NSArray*)users toGroup:(NSString *)group error:(NSError **)error;
 -(BOOL)removeUsers:(NSArray*)users fromGroup:(NSString *)group error:(NSError **)error;
 
 -(BOOL)changePassword:(NSString*)password to:(NSString*)newPassword user:(NSString* )user error:(NSError**)error;
 
+/**
+ *  Sets new passwords for a list of users.  Users are looked up a batch at a time and the changes run with bounded concurrency across node and nodeHandles.
+ *  @discussion the generator is called once per user from the worker threads and may return nil to skip a user. Records are only synchronized when synchronize is YES.  Passwords never reach the log, the job or the progress handler; per user outcomes are on the editor's job.
+ */
+-(BOOL)changePasswordsForUsers:(NSArray*)users generator:(NSString*(^)(NSString *user))generator synchronize:(BOOL)synchronize error:(NSError**)error;
+
+@end
+
+@interface ODUser (odAttributes)
+/**
+ *  attributes to create the user with.  A missing uid, shell or primary group is filled in with the default and set on the user
+ */
+@property (copy,nonatomic,readonly) NSDictionary* openDirectoryAttributes;
+/**
+ *  only the attributes set on the user, no defaults are filled in and the user is left unchanged
+ */
+@property (copy,nonatomic,readonly) NSDictionary* suppliedAttributes;
 @end
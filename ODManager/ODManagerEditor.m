@@ -26,15 +26,19 @@
 #import <OpenDirectory/OpenDirectory.h>
 #import "ODManagerRecord.h"
 #import "ODManagerError.h"
+#import "ODPresetTemplate.h"
+#import "ODManagerJournal.h"
+#import "ODGIDAllocator.h"
 #import "TBXML.h"
 
-@interface ODUser (odAttributes)
-@property (copy,nonatomic,readonly) NSDictionary* openDirectoryAttributes;
+static NSUInteger const kODMDefaultEditorConcurrency = 4;
+static NSUInteger const kODMDefaultEditorBatchSize = 25;
+
+@interface ODManagerEditor ()
+@property (copy, readwrite) NSDictionary *addedMembers;
 @end
 
-@implementation ODManagerEditor{
-    double progress;
-}
+@implementation ODManagerEditor
 
 #pragma mark - Singleton
 +(ODManagerEditor *)sharedEditor{
@@ -47,12 +51,12 @@
 }
 
 #pragma mark - Iniitializers
+-(id)init{
+    return [self initWithNode:nil job:nil];
+}
+
 -(id)initWithNode:(ODNode *)node{
-    self = [super init];
-    if(self){
-        _node = node;
-    }
-    return self;
+    return [self initWithNode:node job:nil];
 }
 
 -(id)initWithNode:(ODNode *)node status:(BOOL)status{
@@ -63,103 +67,186 @@
     return self;
 }
 
+-(id)initWithNode:(ODNode *)node job:(ODManagerJob *)job{
+    self = [super init];
+    if(self){
+        _node = node;
+        _job = job ? job : [ODManagerJob new];
+    }
+    return self;
+}
+
+#pragma mark - Job Accessors
+-(BOOL)continueImport{
+    return !_job.isCancelled;
+}
+
+-(void)setContinueImport:(BOOL)continueImport{
+    if(!continueImport)[_job cancel];
+}
+
+-(BOOL)cancelRemoval{
+    return _job.isCancelled;
+}
+
+-(void)setCancelRemoval:(BOOL)cancelRemoval{
+    if(cancelRemoval)[_job cancel];
+}
+
+-(void (^)(NSError *))errorReplyBlock{
+    return _job.completionHandler;
+}
+
+-(void)setErrorReplyBlock:(void (^)(NSError *))errorReplyBlock{
+    _job.completionHandler = errorReplyBlock;
+}
+
+-(void (^)(NSString *, double))progressUpdateBlock{
+    return _job.progressHandler;
+}
+
+-(void)setProgressUpdateBlock:(void (^)(NSString *, double))progressUpdateBlock{
+    _job.progressHandler = progressUpdateBlock;
+}
+
 #pragma mark - ODUser
 -(BOOL)addUsers:(ODRecordList*)list error:(NSError*__autoreleasing*)error{
-    _continueImport = YES;
+    return [self addUsers:list presetTemplate:nil error:error];
+}
+
+-(BOOL)addUsers:(ODRecordList*)list presetTemplate:(ODPresetTemplate*)presetTemplate error:(NSError*__autoreleasing*)error{
     NSInteger faults = 0;
     NSError *err;
-    NSMutableArray* failures = [[NSMutableArray alloc]initWithCapacity:list.users.count];
-    NSMutableArray* success = [[NSMutableArray alloc]initWithCapacity:list.users.count];
     BOOL rc = YES;
+    ODManagerJob *job = _job;
     
     if(!_node){
         [ODManagerError errorWithCode:kODMerrNoDirectoryNode error:&err];
-        if(_errorReplyBlock)_errorReplyBlock(err);
+        if(error)*error = err;
+        [job finishWithError:err];
         return NO;
     }
     
-    if(list.users.count == 1){
-        ODRecord *check = [ODManagerRecord getUserRecord:[(ODUser*)list.users[0] userName] node:_node error:nil];
-        if(check){
-            [ODManagerError errorWithCode:kODMerrUserAlreadyExists error:error];
-            return NO;
-        }
-    }
-    
-    progress = 0.0;
+    [job beginWithTotal:list.users.count];
+    double total = list.users.count;
     for(ODUser* user in list.users){
-        [[NSOperationQueue mainQueue]addOperationWithBlock:^{
-            progress++;
-            if(_progressUpdateBlock){
-                _progressUpdateBlock(user.userName,(progress/list.users.count*100));
-            }
-            if(_delegate)
-                [_delegate didAddRecord:user.userName progress:(progress/list.users.count*100)];
-        }];
-        
-        if(!_continueImport){
-            [ODManagerError errorWithMessage:@"Import Canceled" error:error];
-            if(_errorReplyBlock && error)_errorReplyBlock(*error);
-            return NO;
+        if(![job checkpoint]){
+            break;
         }
         
         if(!user.userName || !user.passWord || !user.firstName || !user.lastName){
-            [ODManagerError errorWithCode:kODMerrIncompleteUserObject error:error];
+            [ODManagerError errorWithCode:kODMerrIncompleteUserObject error:&err];
+            [job recordFailure:user.userName error:err];
+            faults++;
+            rc = NO;
+            continue;
         }
         
-        ODRecord *userRecord = [_node createRecordWithRecordType:kODRecordTypeUsers
-                                                            name:user.userName
-                                                      attributes:user.openDirectoryAttributes
-                                                           error:&err];
-        if(err){
-            if(error)*error = err;
-            [failures addObject:user.userName];
+        /* finished by an earlier run of this job */
+        if([_journal hasCompletedStage:kODMJournalCreated|kODMJournalPasswordSet forRecord:user.userName]){
+            [job recordSuccess:user.userName];
+            continue;
+        }
+        
+        NSError *userError;
+        ODRecord *userRecord;
+        if([_journal hasCompletedStage:kODMJournalCreated forRecord:user.userName]){
+            userRecord = [ODManagerRecord getUserRecord:user.userName node:_node error:&userError];
+        }else if(list.users.count == 1 && !_journal && [ODManagerRecord getUserRecord:user.userName node:_node error:nil]){
+            [ODManagerError errorWithCode:kODMerrUserAlreadyExists error:&userError];
+        }else{
+            /* the intent is on disk before the record is, so after a crash a record that exists
+               can be told apart from an account this job never made */
+            if(_journal){
+                [_journal markStage:kODMJournalCreating forRecord:user.userName];
+                if(![_journal synchronize:&userError]){
+                    err = userError;
+                    [job recordFailure:user.userName error:userError];
+                    faults++;
+                    rc = NO;
+                    continue;
+                }
+            }
+            NSDictionary *attributes = presetTemplate ? [presetTemplate attributesForUser:user] : user.openDirectoryAttributes;
+            userRecord = [_node createRecordWithRecordType:kODRecordTypeUsers
+                                                      name:user.userName
+                                                attributes:attributes
+                                                     error:&userError];
+            if(!userRecord && [userError.domain isEqualToString:ODFrameworkErrorDomain] && userError.code == kODErrorRecordAlreadyExists){
+                if([_journal hadStageWhenOpened:kODMJournalCreating forRecord:user.userName] &&
+                   ![_journal hasCompletedStage:kODMJournalExisted forRecord:user.userName]){
+                    /* an earlier run created it and crashed before logging that, carry on to its password */
+                    userRecord = [ODManagerRecord getUserRecord:user.userName node:_node error:&userError];
+                }else{
+                    /* somebody else's account, never touch its password, and remember that so a rerun
+                       doesn't mistake this attempt's intent for an account it made */
+                    [_journal markStage:kODMJournalExisted forRecord:user.userName];
+                    userError = nil;
+                    [ODManagerError errorWithCode:kODMerrUserAlreadyExists error:&userError];
+                }
+            }
+            if(userRecord)[_journal markStage:kODMJournalCreated forRecord:user.userName];
+        }
+        
+        if(!userRecord){
+            err = userError;
+            [job recordFailure:user.userName error:userError];
             faults++;
             rc = NO;
         }else{
-            if(user.passWord){
-                rc = [userRecord changePassword:nil toPassword:user.passWord error:&err];
-                if(rc)
-                    [success addObject:user.userName];
+            rc = [userRecord changePassword:nil toPassword:user.passWord error:&userError];
+            if(rc){
+                [_journal markStage:kODMJournalPasswordSet forRecord:user.userName];
+                [job recordSuccess:user.userName];
+            }else{
+                err = userError;
+                [job recordFailure:user.userName error:userError];
+                faults++;
             }
-            else
-               [ODManagerError errorWithCode:kODMerrNoPasswordSupplied error:&err];
-        };
+        }
+        
+        if(_delegate){
+            NSString *userName = user.userName;
+            double progress = job.completed/total*100;
+            [[NSOperationQueue mainQueue]addOperationWithBlock:^{
+                [_delegate didAddRecord:userName progress:progress];
+            }];
+        }
     }
     
-    if(faults > 0 && list.users.count > 1){
+    if(job.isCancelled){
+        [ODManagerError errorWithMessage:@"Import Canceled" error:&err];
+        rc = NO;
+    }else if(faults > 0 && list.users.count > 1){
         [ODManagerError errorWithMessage:@"error adding users.  See log for more info" error:&err];
     }
 
-    if(_errorReplyBlock)_errorReplyBlock(err);
     if(error)*error = err;
 
-    if(list.users.count == 1){
-        return rc;
-    }else{
-        [[self class] logResults:@[@"user",@""] success:success failure:failures];
+    if(list.users.count > 1){
+        [[self class] logResult:job.result action:@"Adding users"];
     }
-    
-    return YES;
+    /* every exit, canceled or not, keeps what was done */
+    [_journal synchronize:nil];
+    [job finishWithError:err];
+
+    if(job.isCancelled)return NO;
+    return list.users.count == 1 ? rc : YES;
 }
 /***/
 
 -(BOOL)addUsers:(ODRecordList *)list withPreset:(NSString *)preset error:(NSError *__autoreleasing *)error{
+    ODPresetTemplate *presetTemplate;
     if(preset){
-        ODRecord* record = [ODManagerRecord getPresetRecord:preset node:_node error:error];
-        if(!record){
-            return [ODManagerError errorWithCode:kODMerrNoPresetRecord error:error];
-        }
-        
-        for (ODUser* user in list.users) {
-            user.userShell = [record userShell] ;
-            user.nfsPath   = [record NFSHomeDirectory];
-            user.primaryGroup = [record primaryGroup];
-            user.sharePath = [record sharePath];
-            user.sharePoint = [record sharePoint];
+        NSError *err;
+        presetTemplate = [ODPresetTemplate templateForPreset:preset node:_node error:&err];
+        if(!presetTemplate){
+            if(error)*error = err;
+            [_job finishWithError:err];
+            return NO;
         }
     }
-    return [self addUsers:list error:error];
+    return [self addUsers:list presetTemplate:presetTemplate error:error];
 }
 
 /* ***/
@@ -170,89 +257,468 @@
 
 -(BOOL)removeListOfUsers:(NSArray *)users error:(NSError *__autoreleasing *)error{
     BOOL rc = NO;
+    NSError *err;
+    ODManagerJob *job = _job;
     
-    _cancelRemoval = NO;
+    [job beginWithTotal:users.count];
     for (NSString* user in users){
-        if(_cancelRemoval){
-            return [ODManagerError errorWithMessage:@"ODUser Removal Canceled" error:error];
+        if(![job checkpoint]){
+            [ODManagerError errorWithMessage:@"ODUser Removal Canceled" error:&err];
+            if(error)*error = err;
+            [job finishWithError:err];
+            return NO;
+        }
+        NSError *userError;
+        ODRecord* userRecord = [ODManagerRecord getUserRecord:user node:_node error:&userError];
+        rc = [userRecord deleteRecordAndReturnError:&userError];
+        if(rc){
+            [job recordSuccess:user];
+        }else{
+            err = userError;
+            [job recordFailure:user error:userError];
         }
-        ODRecord* userRecord = [ODManagerRecord getUserRecord:user node:_node error:error];
-        rc = [userRecord deleteRecordAndReturnError:error];
     }
 
+    if(error)*error = err;
+    [job finishWithError:err];
     return users.count > 1 ? YES:rc;
 }
 /* ***/
 
+-(BOOL)removeListOfUsers:(NSArray *)users cleanMemberships:(BOOL)cleanMemberships error:(NSError *__autoreleasing *)error{
+    __block NSError *err;
+    ODManagerJob *job = _job;
+    ODNode *node = _node;
+    
+    if(!node){
+        [ODManagerError errorWithCode:kODMerrNoDirectoryNode error:&err];
+        if(error)*error = err;
+        [job finishWithError:err];
+        return NO;
+    }
+    
+    /* resolve every target and every group up front */
+    NSDictionary *records = [ODManagerRecord recordsOfType:kODRecordTypeUsers
+                                                     names:users
+                                                attributes:@[kODAttributeTypeRecordName,kODAttributeTypeGUID]
+                                                      node:node
+                                                     error:&err];
+    NSDictionary *groups;
+    if(records && cleanMemberships){
+        groups = [ODManagerRecord recordsOfType:kODRecordTypeGroups
+                                     attributes:@[kODAttributeTypeRecordName,kODAttributeTypeGroupMembership,kODAttributeTypeGroupMembers]
+                                           node:node
+                                          error:&err];
+    }
+    if(!records || (cleanMemberships && !groups)){
+        if(error)*error = err;
+        [job finishWithError:err];
+        return NO;
+    }
+    
+    [job beginWithTotal:users.count];
+    for(NSString *user in users){
+        if(!records[user]){
+            NSError *missing;
+            [ODManagerError errorWithCode:kODMerrNoUserRecord error:&missing];
+            [job recordFailure:user error:missing];
+        }
+    }
+    
+    NSOperationQueue *queue = [NSOperationQueue new];
+    queue.maxConcurrentOperationCount = _maxConcurrentOperations ? _maxConcurrentOperations : kODMDefaultEditorConcurrency;
+    NSMutableDictionary *removed = [[NSMutableDictionary alloc]initWithCapacity:records.count];
+    
+    [job addBatchesOfItems:records.allKeys size:kODMDefaultEditorBatchSize toQueue:queue block:^(NSString *user) {
+        ODRecord *record = records[user];
+        NSString *guid = [[record valuesForAttribute:kODAttributeTypeGUID error:nil] lastObject];
+        NSError *userError;
+        if([record deleteRecordAndReturnError:&userError]){
+            @synchronized(removed){
+                removed[user] = guid ? guid : @"";
+            }
+            [job recordSuccess:user];
+        }else{
+            @synchronized(job){
+                err = userError;
+            }
+            [job recordFailure:user error:userError];
+        }
+    }];
+    [queue waitUntilAllOperationsAreFinished];
+    
+    /* always clean up after the users that were removed, even if the job was canceled */
+    if(cleanMemberships && removed.count){
+        NSError *groupError;
+        if(![[self class] removeMembers:removed fromGroupRecords:groups.allValues queue:queue error:&groupError]){
+            err = groupError;
+        }
+    }
+    
+    if(job.isCancelled){
+        [ODManagerError errorWithMessage:@"ODUser Removal Canceled" error:&err];
+    }
+    if(error)*error = err;
+    [job finishWithError:err];
+    return err == nil;
+}
+/* ***/
+
++(BOOL)removeMembers:(NSDictionary *)removed fromGroupRecords:(NSArray *)groups queue:(NSOperationQueue *)queue error:(NSError *__autoreleasing *)error{
+    __block NSError *err;
+    NSSet *removedNames = [NSSet setWithArray:removed.allKeys];
+    NSSet *removedGUIDs = [NSSet setWithArray:removed.allValues];
+    
+    for(ODRecord *group in groups){
+        NSArray *membership = [group valuesForAttribute:kODAttributeTypeGroupMembership error:nil];
+        NSArray *remaining = [membership filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"NOT SELF IN %@",removedNames]];
+        if(remaining.count == membership.count){
+            continue;
+        }
+        NSArray *members = [group valuesForAttribute:kODAttributeTypeGroupMembers error:nil];
+        NSArray *remainingMembers = [members filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"NOT SELF IN %@",removedGUIDs]];
+        
+        [queue addOperationWithBlock:^{
+            NSError *groupError;
+            BOOL rc = remaining.count ? [group setValue:remaining forAttribute:kODAttributeTypeGroupMembership error:&groupError]
+                                      : [group removeValuesForAttribute:kODAttributeTypeGroupMembership error:&groupError];
+            if(rc && members){
+                rc = remainingMembers.count ? [group setValue:remainingMembers forAttribute:kODAttributeTypeGroupMembers error:&groupError]
+                                            : [group removeValuesForAttribute:kODAttributeTypeGroupMembers error:&groupError];
+            }
+            if(!rc){
+                [ODManagerError logError:groupError];
+                @synchronized(removed){
+                    err = groupError;
+                }
+            }
+        }];
+    }
+    [queue waitUntilAllOperationsAreFinished];
+    
+    if(error)*error = err;
+    return err == nil;
+}
+/* ***/
+
 #pragma mark - ODGroup
 -(BOOL)addGroup:(ODGroup *)group error:(NSError *__autoreleasing *)error{
-    return NO;
+    ODRecordList *list = [ODRecordList new];
+    list.groups = @[group];
+    return [self addGroups:list error:error];
 }
 /* ***/
 
--(BOOL)removeGroup:(ODRecord *)group error:(NSError *__autoreleasing *)error{
-    return NO;
+-(BOOL)addGroups:(ODRecordList *)list error:(NSError *__autoreleasing *)error{
+    self.addedMembers = nil;
+    __block NSError *err;
+    ODManagerJob *job = _job;
+    ODNode *node = _node;
+    
+    if(!node){
+        [ODManagerError errorWithCode:kODMerrNoDirectoryNode error:&err];
+        if(error)*error = err;
+        [job finishWithError:err];
+        return NO;
+    }
+    
+    /* which groups already exist and the GUID of every member, in two queries */
+    NSMutableArray *names = [NSMutableArray arrayWithCapacity:list.groups.count];
+    NSMutableSet *memberNames = [NSMutableSet new];
+    for(ODGroup *group in list.groups){
+        if(group.groupName)[names addObject:group.groupName];
+        if(group.members)[memberNames addObjectsFromArray:group.members];
+    }
+    NSDictionary *existing = [ODManagerRecord recordsOfType:kODRecordTypeGroups
+                                                      names:names
+                                                 attributes:@[kODAttributeTypeRecordName]
+                                                       node:node
+                                                      error:&err];
+    NSDictionary *users = @{};
+    if(existing && memberNames.count){
+        users = [ODManagerRecord recordsOfType:kODRecordTypeUsers
+                                         names:memberNames.allObjects
+                                    attributes:@[kODAttributeTypeRecordName,kODAttributeTypeGUID]
+                                          node:node
+                                         error:&err];
+    }
+    
+    ODGIDAllocator *allocator = _gidAllocator;
+    if(!allocator){
+        allocator = [ODGIDAllocator new];
+        _gidAllocator = allocator;
+    }
+    /* read again for every job, other tools and admins add groups the shared allocator has not seen */
+    [allocator setNeedsLoad];
+    if(existing && users && ![allocator loadIfNeededFromNode:node error:&err]){
+        allocator = nil;
+    }
+    if(!existing || !users || !allocator){
+        if(error)*error = err;
+        [job finishWithError:err];
+        return NO;
+    }
+    
+    [job beginWithTotal:list.groups.count];
+    NSMutableDictionary *addedMembers = [NSMutableDictionary new];
+    NSMutableArray *pending = [NSMutableArray arrayWithCapacity:list.groups.count];
+    for(ODGroup *group in list.groups){
+        NSError *groupError;
+        if(!group.groupName){
+            [ODManagerError errorWithCode:kODMerrIncompleteGroupObject error:&groupError];
+            [job recordFailure:group.fullName ? group.fullName : @"" error:groupError];
+        }else if(existing[group.groupName]){
+            [ODManagerError errorWithCode:kODMerrCouldNotAddGroup error:&groupError];
+            [job recordFailure:group.groupName error:groupError];
+        }else{
+            [pending addObject:group];
+        }
+    }
+    
+    NSOperationQueue *queue = [NSOperationQueue new];
+    queue.maxConcurrentOperationCount = _maxConcurrentOperations ? _maxConcurrentOperations : kODMDefaultEditorConcurrency;
+    double total = list.groups.count;
+    
+    [job addBatchesOfItems:pending size:kODMDefaultEditorBatchSize toQueue:queue block:^(ODGroup *group) {
+        NSError *groupError;
+        
+        NSUInteger gid = group.gid ? [self claimRequestedGID:group.gid allocator:allocator error:&groupError] : [allocator allocateID];
+        if(gid == NSNotFound){
+            if(!groupError)[ODManagerError errorWithCode:kODMerrCouldNotAddGroup error:&groupError];
+            @synchronized(job){
+                err = groupError;
+            }
+            [job recordFailure:group.groupName error:groupError];
+            return;
+        }
+        
+        NSMutableDictionary *attributes = [NSMutableDictionary dictionaryWithObject:@[[@(gid) stringValue]] forKey:kODAttributeTypePrimaryGroupID];
+        if(group.fullName){
+            attributes[kODAttributeTypeFullName] = @[group.fullName];
+        }
+        if(group.guid){
+            attributes[kODAttributeTypeGUID] = @[group.guid];
+        }
+        
+        /* members go in with the record rather than one write each afterwards */
+        if(group.members.count){
+            NSMutableArray *membership = [NSMutableArray arrayWithCapacity:group.members.count];
+            NSMutableArray *guids = [NSMutableArray arrayWithCapacity:group.members.count];
+            for(NSString *member in group.members){
+                NSString *guid = [[users[member] valuesForAttribute:kODAttributeTypeGUID error:nil] lastObject];
+                if(guid){
+                    [membership addObject:member];
+                    [guids addObject:guid];
+                }else{
+                    NSLog(@"Not adding %@ to %@, no such user",member,group.groupName);
+                }
+            }
+            if(membership.count){
+                attributes[kODAttributeTypeGroupMembership] = membership;
+                attributes[kODAttributeTypeGroupMembers] = guids;
+            }
+        }
+        
+        if([node createRecordWithRecordType:kODRecordTypeGroups name:group.groupName attributes:attributes error:&groupError]){
+            @synchronized(addedMembers){
+                addedMembers[group.groupName] = attributes[kODAttributeTypeGroupMembership] ? attributes[kODAttributeTypeGroupMembership] : @[];
+            }
+            [job recordSuccess:group.groupName];
+            if(_delegate){
+                NSString *groupName = group.groupName;
+                double progress = job.completed/total*100;
+                [[NSOperationQueue mainQueue]addOperationWithBlock:^{
+                    [_delegate didAddRecord:groupName progress:progress];
+                }];
+            }
+        }else{
+            [allocator releaseID:gid];
+            @synchronized(job){
+                err = groupError;
+            }
+            [job recordFailure:group.groupName error:groupError];
+        }
+    }];
+    [queue waitUntilAllOperationsAreFinished];
+    self.addedMembers = addedMembers;
+    
+    if(job.isCancelled){
+        [ODManagerError errorWithMessage:@"Group Import Canceled" error:&err];
+    }else if(job.result.failureCount && list.groups.count > 1){
+        [ODManagerError errorWithMessage:@"error adding groups.  See log for more info" error:&err];
+    }
+    if(list.groups.count > 1){
+        [[self class] logResult:job.result action:@"Adding groups"];
+    }
+    if(error)*error = err;
+    [job finishWithError:err];
+    return job.result.failureCount == 0 && !job.isCancelled;
+}
+/* ***/
+
+/* a gid that was asked for must be a whole positive number that no other group uses, in range or not */
+-(NSUInteger)claimRequestedGID:(NSString*)requested allocator:(ODGIDAllocator*)allocator error:(NSError *__autoreleasing *)error{
+    NSUInteger gid = [ODGIDAllocator IDFromString:requested];
+    if(gid == NSNotFound){
+        [ODManagerError errorWithMessage:[NSString stringWithFormat:@"%@ is not a valid group ID",requested] error:error];
+        return NSNotFound;
+    }
+    
+    /* the allocator only read the IDs in its range, anything else is looked up */
+    if(gid < allocator.firstID || gid > allocator.lastID){
+        ODQuery *query = [ODQuery queryWithNode:_node
+                                 forRecordTypes:kODRecordTypeGroups
+                                      attribute:kODAttributeTypePrimaryGroupID
+                                      matchType:kODMatchEqualTo
+                                    queryValues:[@(gid) stringValue]
+                               returnAttributes:kODAttributeTypeRecordName
+                                 maximumResults:1
+                                          error:error];
+        NSArray *matches = [query resultsAllowingPartial:NO error:error];
+        if(!matches){
+            return NSNotFound;
+        }
+        if(matches.count){
+            [ODManagerError errorWithMessage:[NSString stringWithFormat:@"group ID %lu is already used",(unsigned long)gid] error:error];
+            return NSNotFound;
+        }
+    }
+    
+    if(![allocator claimID:gid]){
+        [ODManagerError errorWithMessage:[NSString stringWithFormat:@"group ID %lu is already used",(unsigned long)gid] error:error];
+        return NSNotFound;
+    }
+    return gid;
+}
+/* ***/
+
+-(BOOL)removeGroup:(NSString *)group error:(NSError *__autoreleasing *)error{
+    return [self removeGroups:@[group] error:error];
+}
+/* ***/
+
+-(BOOL)removeGroups:(NSArray *)groups error:(NSError *__autoreleasing *)error{
+    __block NSError *err;
+    ODManagerJob *job = _job;
+    ODNode *node = _node;
+    
+    if(!node){
+        [ODManagerError errorWithCode:kODMerrNoDirectoryNode error:&err];
+        if(error)*error = err;
+        [job finishWithError:err];
+        return NO;
+    }
+    
+    NSDictionary *records = [ODManagerRecord recordsOfType:kODRecordTypeGroups
+                                                     names:groups
+                                                attributes:@[kODAttributeTypeRecordName,kODAttributeTypePrimaryGroupID]
+                                                      node:node
+                                                     error:&err];
+    if(!records){
+        if(error)*error = err;
+        [job finishWithError:err];
+        return NO;
+    }
+    
+    [job beginWithTotal:groups.count];
+    for(NSString *group in groups){
+        if(!records[group]){
+            NSError *missing;
+            [ODManagerError errorWithCode:kODMerrNoGroupRecord error:&missing];
+            [job recordFailure:group error:missing];
+        }
+    }
+    
+    NSOperationQueue *queue = [NSOperationQueue new];
+    queue.maxConcurrentOperationCount = _maxConcurrentOperations ? _maxConcurrentOperations : kODMDefaultEditorConcurrency;
+    ODGIDAllocator *allocator = _gidAllocator;
+    
+    [job addBatchesOfItems:records.allKeys size:kODMDefaultEditorBatchSize toQueue:queue block:^(NSString *group) {
+        ODRecord *record = records[group];
+        NSString *gid = [[record valuesForAttribute:kODAttributeTypePrimaryGroupID error:nil] lastObject];
+        NSError *groupError;
+        if([record deleteRecordAndReturnError:&groupError]){
+            if(gid)[allocator releaseID:gid.integerValue];
+            [job recordSuccess:group];
+        }else{
+            @synchronized(job){
+                err = groupError;
+            }
+            [job recordFailure:group error:groupError];
+        }
+    }];
+    [queue waitUntilAllOperationsAreFinished];
+    
+    if(job.isCancelled){
+        [ODManagerError errorWithMessage:@"Group Removal Canceled" error:&err];
+    }
+    if(groups.count > 1){
+        [[self class] logResult:job.result action:@"Removing groups"];
+    }
+    if(error)*error = err;
+    [job finishWithError:err];
+    return job.result.failureCount == 0 && !job.isCancelled;
 }
 
 #pragma mark - ODUser/ODGroup
 -(BOOL)addUsers:(NSArray*)users toGroup:(NSString *)group error:(NSError *__autoreleasing *)error{
     NSError* err;
     ODRecord* groupRecord = [ODManagerRecord getGroupRecord:group node:_node error:error];
-    NSMutableArray* failures = [[NSMutableArray alloc]initWithCapacity:users.count];
-    NSMutableArray* success = [[NSMutableArray alloc]initWithCapacity:users.count];
-    NSInteger* faults = 0;
+    NSInteger faults = 0;
     BOOL rc = YES;
     double count = 0.0;
-    _continueImport = YES;
-    while(_continueImport){
+    while([_job checkpoint]){
         for(NSString* user in users){
-            if(!_continueImport)break;
+            if(![_job checkpoint])break;
+            if([_journal hasAddedUser:user toGroup:group]){
+                [_job recordSuccess:user];
+                continue;
+            }
             ODRecord* userRecord = [ODManagerRecord getUserRecord:user node:_node error:error];
             if(![groupRecord addMemberRecord:userRecord error:&err]){
                 [ODManagerError logError:err];
-                [failures addObject:user];
+                [_job recordFailure:user error:err];
                 faults++;
                 rc = NO;
             }else{
                 count++;
                 [_delegate didAddUser:user toGroup:group progress:(count/users.count*100)];
-                [success addObject:user];
+                [_job recordSuccess:user];
+                [_journal markUser:user addedToGroup:group];
             }
         }
         break;
     }
+    [_journal synchronize:nil];
     
     if(faults > 0)
         [ODManagerError errorWithMessage:@"error adding users.  See log for more info" error:error];
     if(users.count == 1)
         return rc;
     else
-        [[self class] logResults:@[@"group",group] success:success failure:failures];
+        [[self class] logResult:_job.result action:[NSString stringWithFormat:@"Adding users to %@",group]];
         return YES;
 }
 
 -(BOOL)removeUsers:(NSArray *)users fromGroup:(NSString *)group error:(NSError *__autoreleasing *)error{
     NSError* err;
     ODRecord* groupRecord = [ODManagerRecord getGroupRecord:group node:_node error:error];
-    NSMutableArray* failures = [[NSMutableArray alloc]initWithCapacity:users.count];
-    NSMutableArray* success = [[NSMutableArray alloc]initWithCapacity:users.count];
-    NSInteger* faults = 0;
+    NSInteger faults = 0;
     BOOL rc = YES;
     double count = 0.0;
-    _continueImport = YES;
-    while(_continueImport){
+    while([_job checkpoint]){
         for(NSString* user in users){
-            if(!_continueImport)break;
+            if(![_job checkpoint])break;
             ODRecord* userRecord = [ODManagerRecord getUserRecord:user node:_node error:&err];
             if(![groupRecord removeMemberRecord:userRecord error:&err]){
                 [ODManagerError logError:err];
-                [failures addObject:user];
+                [_job recordFailure:user error:err];
                 faults++;
                 rc = NO;
             }else{
                 count++;
                 [_delegate didRemoveUser:user fromGroup:group progress:(count/users.count*100)];
-                [success addObject:user];
+                [_job recordSuccess:user];
             }
         }
         break;
@@ -263,7 +729,7 @@
     if(users.count == 1)
         return rc;
     else
-        [[self class] logResults:@[@"group",group] success:success failure:failures];
+        [[self class] logResult:_job.result action:[NSString stringWithFormat:@"Removing users from %@",group]];
     return YES;
 }
 
@@ -280,16 +746,84 @@
     return NO;
 }
 
-#pragma mark - Class Methods
-+(void)logResults:(NSArray*)type success:(NSArray*)success failure:(NSArray*)failures{
-    if([type[0] isEqualToString:@"group"]){
-        NSLog(@"Added users to %@: %@",type[1],success);
-        NSLog(@"There were problems adding these users to %@: %@",type[1],failures);
-
-    }else if([type[0] isEqualToString:@"user"]){
-        NSLog(@"Added users: %@",success);
-        NSLog(@"There were problems adding these users %@",failures);
+-(BOOL)changePasswordsForUsers:(NSArray *)users generator:(NSString *(^)(NSString *))generator synchronize:(BOOL)synchronize error:(NSError *__autoreleasing *)error{
+    __block NSError *err;
+    ODManagerJob *job = _job;
+    
+    if(!_node){
+        [ODManagerError errorWithCode:kODMerrNoDirectoryNode error:&err];
+        if(error)*error = err;
+        [job finishWithError:err];
+        return NO;
+    }
+    
+    NSMutableArray *nodes = [NSMutableArray arrayWithObject:_node];
+    if(_nodeHandles)[nodes addObjectsFromArray:_nodeHandles];
+    
+    NSOperationQueue *queue = [NSOperationQueue new];
+    NSUInteger concurrency = _maxConcurrentOperations ? _maxConcurrentOperations : kODMDefaultEditorConcurrency;
+    queue.maxConcurrentOperationCount = MAX(concurrency,nodes.count);
+    
+    [job beginWithTotal:users.count];
+    NSUInteger batchNumber = 0;
+    for(NSUInteger i = 0; i < users.count; i += kODMDefaultEditorBatchSize){
+        NSArray *batch = [users subarrayWithRange:NSMakeRange(i, MIN(kODMDefaultEditorBatchSize, users.count - i))];
+        ODNode *node = nodes[batchNumber++ % nodes.count];
+        
+        [queue addOperationWithBlock:^{
+            if(![job checkpoint])return;
+            
+            /* records belong to the node they were read from, so each batch resolves on its own handle */
+            NSError *batchError;
+            NSDictionary *records = [ODManagerRecord recordsOfType:kODRecordTypeUsers
+                                                             names:batch
+                                                        attributes:@[kODAttributeTypeRecordName]
+                                                              node:node
+                                                             error:&batchError];
+            for(NSString *user in batch){
+                if(![job checkpoint])return;
+                @autoreleasepool {
+                    NSError *userError = batchError;
+                    ODRecord *record = records[user];
+                    NSString *password = record ? generator(user) : nil;
+                    
+                    BOOL rc = NO;
+                    if(!record){
+                        if(!userError)[ODManagerError errorWithCode:kODMerrNoUserRecord error:&userError];
+                    }else if(!password){
+                        [ODManagerError errorWithCode:kODMerrNoPasswordSupplied error:&userError];
+                    }else if([record changePassword:nil toPassword:password error:&userError]){
+                        rc = synchronize ? [record synchronizeAndReturnError:&userError] : YES;
+                    }
+                    
+                    if(rc){
+                        [job recordSuccess:user];
+                    }else{
+                        @synchronized(job){
+                            err = userError;
+                        }
+                        [job recordFailure:user error:userError];
+                    }
+                }
+            }
+        }];
     }
+    [queue waitUntilAllOperationsAreFinished];
+    
+    if(job.isCancelled){
+        [ODManagerError errorWithMessage:@"Password Change Canceled" error:&err];
+    }else if(job.result.failureCount > 1){
+        [ODManagerError errorWithMessage:@"error changing passwords.  See the job's errors for more info" error:&err];
+    }
+    if(error)*error = err;
+    [job finishWithError:err];
+    return err == nil;
+}
+
+#pragma mark - Class Methods
+/* counts only, per record outcomes are on the job's result */
++(void)logResult:(ODManagerResult*)result action:(NSString*)action{
+    NSLog(@"%@: %@",action,[result summary]);
 }
 @end
 
@@ -297,20 +831,6 @@
 @implementation ODUser (odAttributes)
 
 -(NSDictionary *)openDirectoryAttributes{
-    NSMutableDictionary *settings;
-    settings = [[NSMutableDictionary alloc]init];
-    if(self.sharePoint){
-        [settings setObject:@[self.homeDirectory] forKey:@"dsAttrTypeStandard:HomeDirectory"];
-    }
-    if(self.nfsPath){
-        NSString *nfsHome = [self.nfsPath stringByAppendingPathComponent:self.userName];
-        [settings setObject:@[nfsHome] forKey:@"dsAttrTypeStandard:NFSHomeDirectory"];
-    }
-    
-    if(self.emailDomain){
-        NSString *emailAddress = [NSString stringWithFormat:@"%@@%@",self.userName,self.emailDomain];
-        [settings setObject:@[emailAddress] forKey:@"dsAttrTypeStandard:EMailAddress"];
-    }
     if(!self.uid){
         self.uid = [self.userName uuidWithLength:6];
     }
@@ -320,13 +840,34 @@
     if(!self.primaryGroup){
         self.primaryGroup = @"20";
     }
-    [settings setObject:@[[NSString stringWithFormat:@"%@ %@",self.firstName,self.lastName]] forKey:@"dsAttrTypeStandard:RealName"];
-    [settings setObject:@[self.firstName] forKey:@"dsAttrTypeStandard:FirstName"];
-    [settings setObject:@[self.lastName] forKey:@"dsAttrTypeStandard:LastName"];
-    [settings setObject:@[self.uid] forKey:@"dsAttrTypeStandard:UniqueID"];
-    [settings setObject:@[self.primaryGroup] forKey:@"dsAttrTypeStandard:PrimaryGroupID"];
-    [settings setObject:@[self.userShell] forKey:@"dsAttrTypeStandard:UserShell"];
-    return [NSDictionary dictionaryWithDictionary:settings];
+    return self.suppliedAttributes;
+}
+
+-(NSDictionary *)suppliedAttributes{
+    NSMutableDictionary *settings = [[NSMutableDictionary alloc]initWithCapacity:9];
+    NSString *userName = self.userName;
+    if(self.sharePoint && self.homeDirectory){
+        [settings setObject:@[self.homeDirectory] forKey:@"dsAttrTypeStandard:HomeDirectory"];
+    }
+    if(self.nfsPath && userName){
+        NSString *nfsHome = [self.nfsPath stringByAppendingPathComponent:userName];
+        [settings setObject:@[nfsHome] forKey:@"dsAttrTypeStandard:NFSHomeDirectory"];
+    }
+    
+    if(self.emailDomain && userName){
+        NSString *emailAddress = [[userName stringByAppendingString:@"@"] stringByAppendingString:self.emailDomain];
+        [settings setObject:@[emailAddress] forKey:@"dsAttrTypeStandard:EMailAddress"];
+    }
+    if(self.firstName && self.lastName){
+        NSString *realName = [[self.firstName stringByAppendingString:@" "] stringByAppendingString:self.lastName];
+        [settings setObject:@[realName] forKey:@"dsAttrTypeStandard:RealName"];
+    }
+    if(self.firstName)[settings setObject:@[self.firstName] forKey:@"dsAttrTypeStandard:FirstName"];
+    if(self.lastName)[settings setObject:@[self.lastName] forKey:@"dsAttrTypeStandard:LastName"];
+    if(self.uid)[settings setObject:@[self.uid] forKey:@"dsAttrTypeStandard:UniqueID"];
+    if(self.primaryGroup)[settings setObject:@[self.primaryGroup] forKey:@"dsAttrTypeStandard:PrimaryGroupID"];
+    if(self.userShell)[settings setObject:@[self.userShell] forKey:@"dsAttrTypeStandard:UserShell"];
+    return settings;
 }
 
-@end
\ No newline at end of file
+@end
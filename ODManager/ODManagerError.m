@@ -29,11 +29,46 @@ static NSString *const errorDomain = @"com.eeaapps.odmanager";
 
 @implementation ODManagerError
 +(BOOL)errorWithCode:(OSStatus)code error:(NSError *__autoreleasing *)error{
+    if(code == kODMerrSuccess){
+        return YES;
+    }
+    /* the message is looked up when it's first read, bulk jobs can make thousands of these */
+    if(error)
+        *error = [ODManagerError errorWithDomain:errorDomain code:code userInfo:nil];
+    return NO;
+}
+
+-(NSString *)localizedDescription{
+    NSString *message = self.userInfo[NSLocalizedDescriptionKey];
+    return message ? message : [[self class] messageForCode:(OSStatus)self.code];
+}
+
+/* send a plain NSError over the wire, the other side doesn't know this class */
+-(id)replacementObjectForCoder:(NSCoder *)aCoder{
+    return [NSError errorWithDomain:self.domain code:self.code userInfo:@{NSLocalizedDescriptionKey:self.localizedDescription}];
+}
+
++(NSString*)messageForCode:(OSStatus)code{
+    static NSMutableDictionary *messages;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        messages = [NSMutableDictionary new];
+    });
+    @synchronized(messages){
+        NSString *message = messages[@(code)];
+        if(!message){
+            message = [self lookupMessageForCode:code];
+            messages[@(code)] = message;
+        }
+        return message;
+    }
+}
+
++(NSString*)lookupMessageForCode:(OSStatus)code{
     NSString *message = nil;
     NSBundle *bundel = [NSBundle bundleForClass:[self class]];
     NSString *tabel = @"ODManagerStrings";
     switch (code) {
-        case kODMerrSuccess: return YES;
         case kODMerrCouldNotConnectToNode: {
             message = NSLocalizedStringFromTableInBundle(@"errNoNode", tabel, bundel, nil);
             break;
@@ -106,11 +141,7 @@ static NSString *const errorDomain = @"com.eeaapps.odmanager";
 			message = NSLocalizedStringFromTableInBundle(@"errDefault", tabel, bundel, nil);
 		}
     }
-    if(error)
-        *error = [NSError errorWithDomain:errorDomain
-                               code:code
-                           userInfo:@{NSLocalizedDescriptionKey:message}];
-    return NO;
+    return message ? message : @"";
 }
 
 
@@ -0,0 +1,144 @@
+//
+//  ODManagerExporter.h
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+@class ODNode, ODManagerJob;
+
+typedef NS_ENUM(NSInteger, ODMExportFormat) {
+    /** one JSON object per record: type, name and every exported attribute as an array of strings */
+    kODMExportJSONLines = 0,
+    /** dsimport file, one record type per file */
+    kODMExportDSImport,
+};
+
+/**
+ *  Streams every record of the given types to a file.
+ *  @discussion Enumeration is split by record name prefix into shards that are queried in parallel, spread across nodes.
+ *  A shard that fills a page is split into a query for the exact prefix plus one longer prefix per alphabet character, so no query returns more than pageSize records.
+ *  Prefixes only reach names made of alphabet characters, so once the shards finish a RecordName only listing of each type finds the remaining names and reads them back by exact name.
+ *  A listed record that can't be read back fails the export.  Finished pages go through a writer that holds at most maxPendingPages;
+ *  beyond that only the names already written are kept, to write each record once and check coverage.
+ */
+@interface ODManagerExporter : NSObject
+
+/**
+ *  nodes the shards are spread over, the primary and any replicas
+ */
+@property (copy) NSArray* nodes;
+
+/**
+ *  record types to export, users and groups by default
+ */
+@property (copy) NSArray* recordTypes;
+
+@property ODMExportFormat format;
+
+/**
+ *  attributes to export.  nil for every standard attribute in JSON lines, and for +defaultDSImportAttributesForType: in dsimport
+ */
+@property (copy) NSArray* attributes;
+
+/**
+ *  characters shards are split on, each starts a shard.  Defaults to lower case letters, digits and _-.
+ *  @discussion only decides how the work is spread; names with other characters are exported by the coverage pass, which reads them one page of names at a time
+ */
+@property (copy) NSString* alphabet;
+
+/**
+ *  most records one query returns, default 1000
+ */
+@property NSUInteger pageSize;
+
+/**
+ *  shard queries run at once, default 4
+ */
+@property NSUInteger maxConcurrentQueries;
+
+/**
+ *  pages waiting for the writer before queries stop, default 8
+ */
+@property NSUInteger maxPendingPages;
+
+/**
+ *  job that each finished shard is recorded on, and that pauses or cancels the export
+ */
+@property (strong) ODManagerJob* job;
+
+/**
+ *  records written so far
+ */
+@property (readonly) NSUInteger exportedCount;
+
+- (id)initWithNodes:(NSArray*)nodes;
+
+/**
+ *  Export to a file, replacing it
+ *
+ *  @param path  file to write
+ *  @param error populated should error occur
+ *
+ *  @return YES for success, NO on failure.
+ */
+- (BOOL)exportToPath:(NSString*)path error:(NSError**)error;
+
+/**
+ *  Export to an open stream
+ *
+ *  @param stream open output stream, left open
+ *  @param error  populated should error occur
+ *
+ *  @return YES for success, NO on failure.
+ */
+- (BOOL)exportToStream:(NSOutputStream*)stream error:(NSError**)error;
+
+/**
+ *  columns written to a dsimport file when attributes is nil
+ */
++ (NSArray*)defaultDSImportAttributesForType:(NSString*)recordType;
+
+@end
+
+@interface ODManagerExporter (Source)
+/**
+ *  Every read the export makes goes through here; override to export from another source.
+ *
+ *  @param type       record type
+ *  @param prefix     records whose name begins with prefix, or nil
+ *  @param names      records with one of these names when prefix is nil, every record when both are nil
+ *  @param attributes attributes to return, nil for every standard attribute
+ *  @param limit      most records to return, 0 for no limit
+ *  @param node       node to read
+ *  @param error      populated should error occur
+ *
+ *  @return ODRecord objects, nil on failure
+ */
+- (NSArray*)recordsOfType:(NSString*)type
+                   prefix:(NSString*)prefix
+                    names:(NSArray*)names
+               attributes:(NSArray*)attributes
+                    limit:(NSUInteger)limit
+                     node:(ODNode*)node
+                    error:(NSError**)error;
+@end
@@ -0,0 +1,505 @@
+//
+//  ODManagerExporter.m
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "ODManagerExporter.h"
+#import "ODManagerJob.h"
+#import "ODManagerError.h"
+#import <OpenDirectory/OpenDirectory.h>
+
+static NSUInteger const kODMExportDefaultPageSize = 1000;
+static NSUInteger const kODMExportDefaultConcurrency = 4;
+static NSUInteger const kODMExportDefaultPendingPages = 8;
+
+/* a shard this long is read whole even if it fills a page */
+static NSUInteger const kODMExportMaxPrefixLength = 8;
+
+@implementation ODManagerExporter {
+    dispatch_queue_t _writerQueue;
+    dispatch_semaphore_t _pendingPages;
+    NSOutputStream* _stream;
+    NSError* _writeError;
+    NSUInteger _exportedCount;
+    NSMutableDictionary* _exportedNames; // type -> NSMutableSet of record names already written
+}
+
+- (id)init
+{
+    return [self initWithNodes:nil];
+}
+
+- (id)initWithNodes:(NSArray*)nodes
+{
+    self = [super init];
+    if (self) {
+        _nodes = [nodes copy];
+        _recordTypes = @[ kODRecordTypeUsers, kODRecordTypeGroups ];
+        _alphabet = @"abcdefghijklmnopqrstuvwxyz0123456789_-.";
+        _pageSize = kODMExportDefaultPageSize;
+        _maxConcurrentQueries = kODMExportDefaultConcurrency;
+        _maxPendingPages = kODMExportDefaultPendingPages;
+        _job = [ODManagerJob new];
+    }
+    return self;
+}
+
++ (NSArray*)defaultDSImportAttributesForType:(NSString*)recordType
+{
+    if ([recordType isEqualToString:kODRecordTypeGroups]) {
+        return @[ kODAttributeTypeRecordName,
+                  kODAttributeTypeFullName,
+                  kODAttributeTypePrimaryGroupID,
+                  kODAttributeTypeGUID,
+                  kODAttributeTypeGroupMembership,
+                  kODAttributeTypeGroupMembers,
+                  kODAttributeTypeNestedGroups ];
+    }
+    return @[ kODAttributeTypeRecordName,
+              kODAttributeTypeFullName,
+              kODAttributeTypeFirstName,
+              kODAttributeTypeLastName,
+              kODAttributeTypeUniqueID,
+              kODAttributeTypePrimaryGroupID,
+              kODAttributeTypeGUID,
+              kODAttributeTypeNFSHomeDirectory,
+              kODAttributeTypeHomeDirectory,
+              kODAttributeTypeUserShell,
+              kODAttributeTypeEMailAddress ];
+}
+
+- (NSUInteger)exportedCount
+{
+    @synchronized(self)
+    {
+        return _exportedCount;
+    }
+}
+
+#pragma mark - Export
+- (BOOL)exportToPath:(NSString*)path error:(NSError* __autoreleasing*)error
+{
+    NSOutputStream* stream = [NSOutputStream outputStreamToFileAtPath:path append:NO];
+    [stream open];
+    if (stream.streamStatus != NSStreamStatusOpen) {
+        NSError* err = stream.streamError;
+        if (!err) {
+            [ODManagerError errorWithMessage:[NSString stringWithFormat:@"Could not open %@", path] error:&err];
+        }
+        if (error)
+            *error = err;
+        [_job finishWithError:err];
+        return NO;
+    }
+    BOOL rc = [self exportToStream:stream error:error];
+    [stream close];
+    return rc;
+}
+
+- (BOOL)exportToStream:(NSOutputStream*)stream error:(NSError* __autoreleasing*)error
+{
+    __block NSError* err;
+    ODManagerJob* job = _job;
+
+    if (!_nodes.count) {
+        [ODManagerError errorWithCode:kODMerrNoDirectoryNode error:&err];
+    } else if (_format == kODMExportDSImport && _recordTypes.count != 1) {
+        [ODManagerError errorWithMessage:@"A dsimport file holds one record type" error:&err];
+    }
+    if (err) {
+        if (error)
+            *error = err;
+        [job finishWithError:err];
+        return NO;
+    }
+
+    _stream = stream;
+    _writeError = nil;
+    _exportedCount = 0;
+    _exportedNames = [NSMutableDictionary dictionaryWithCapacity:_recordTypes.count];
+    for (NSString* type in _recordTypes) {
+        _exportedNames[type] = [NSMutableSet new];
+    }
+    _writerQueue = dispatch_queue_create("com.eeaapps.odmanager.export", DISPATCH_QUEUE_SERIAL);
+    _pendingPages = dispatch_semaphore_create(_maxPendingPages ? _maxPendingPages : kODMExportDefaultPendingPages);
+
+    if (_format == kODMExportDSImport) {
+        NSString* type = _recordTypes.firstObject;
+        NSArray* columns = [self attributesForType:type];
+        NSString* header = [NSString stringWithFormat:@"0x0A 0x5C 0x3A 0x2C %@ %lu %@\n",
+                                                      type, (unsigned long)columns.count, [columns componentsJoinedByString:@" "]];
+        [self enqueuePage:[[header dataUsingEncoding:NSUTF8StringEncoding] mutableCopy] count:0];
+    }
+
+    /* one operation per first character and type, handed to the nodes in turn */
+    NSMutableArray* shards = [NSMutableArray arrayWithCapacity:_recordTypes.count * _alphabet.length];
+    for (NSString* type in _recordTypes) {
+        for (NSUInteger i = 0; i < _alphabet.length; i++) {
+            [shards addObject:@[ type, [_alphabet substringWithRange:NSMakeRange(i, 1)] ]];
+        }
+    }
+
+    NSOperationQueue* queue = [NSOperationQueue new];
+    queue.maxConcurrentOperationCount = _maxConcurrentQueries ? _maxConcurrentQueries : kODMExportDefaultConcurrency;
+    /* one coverage pass per type after the shards */
+    [job beginWithTotal:shards.count + _recordTypes.count];
+
+    NSArray* nodes = _nodes;
+    [shards enumerateObjectsUsingBlock:^(NSArray* shard, NSUInteger index, BOOL* stop) {
+        ODNode* node = nodes[index % nodes.count];
+        [queue addOperationWithBlock:^{
+            if (![job checkpoint]) {
+                return;
+            }
+            NSError* shardError;
+            NSString* name = [NSString stringWithFormat:@"%@ %@*", shard[0], shard[1]];
+            if ([self exportPrefix:shard[1] type:shard[0] node:node exact:NO error:&shardError]) {
+                [job recordSuccess:name];
+            } else {
+                @synchronized(job)
+                {
+                    err = shardError;
+                }
+                [job recordFailure:name error:shardError];
+            }
+        }];
+    }];
+    [queue waitUntilAllOperationsAreFinished];
+
+    [_recordTypes enumerateObjectsUsingBlock:^(NSString* type, NSUInteger index, BOOL* stop) {
+        ODNode* node = nodes[index % nodes.count];
+        [queue addOperationWithBlock:^{
+            if (![job checkpoint]) {
+                return;
+            }
+            NSError* coverageError;
+            NSString* name = [NSString stringWithFormat:@"%@ coverage", type];
+            if ([self exportUncoveredType:type node:node error:&coverageError]) {
+                [job recordSuccess:name];
+            } else {
+                @synchronized(job)
+                {
+                    err = coverageError;
+                }
+                [job recordFailure:name error:coverageError];
+            }
+        }];
+    }];
+    [queue waitUntilAllOperationsAreFinished];
+
+    /* let the writer drain */
+    dispatch_sync(_writerQueue, ^{
+    });
+    if (_writeError) {
+        err = _writeError;
+    } else if (job.isCancelled) {
+        [ODManagerError errorWithMessage:@"Export Canceled" error:&err];
+    }
+    _stream = nil;
+    _exportedNames = nil;
+
+    if (error)
+        *error = err;
+    [job finishWithError:err];
+    return err == nil;
+}
+
+#pragma mark - Shards
+- (NSArray*)attributesForType:(NSString*)type
+{
+    if (_attributes) {
+        return _attributes;
+    }
+    return _format == kODMExportDSImport ? [[self class] defaultDSImportAttributesForType:type] : nil;
+}
+
+/* Reads one prefix.  When a shard fills its page, the records are dropped and the shard is
+   read again as the exact name plus one longer prefix per character of the alphabet, until each
+   piece fits.  Names that continue with a character outside the alphabet are not matched by any
+   of the longer prefixes; the coverage pass picks them up. */
+- (BOOL)exportPrefix:(NSString*)prefix type:(NSString*)type node:(ODNode*)node exact:(BOOL)exact error:(NSError* __autoreleasing*)error
+{
+    if (![_job checkpoint] || [self writeFailed]) {
+        return YES;
+    }
+
+    NSUInteger limit = (exact || prefix.length >= kODMExportMaxPrefixLength) ? 0 : (_pageSize ? _pageSize : kODMExportDefaultPageSize);
+    NSArray* attributes = [self attributesForType:type];
+    NSArray* records = [self recordsOfType:type
+                                    prefix:exact ? nil : prefix
+                                     names:exact ? @[ prefix ] : nil
+                                attributes:attributes
+                                     limit:limit
+                                      node:node
+                                     error:error];
+    if (!records) {
+        return NO;
+    }
+
+    if (limit && records.count >= limit) {
+        records = nil;
+        if (![self exportPrefix:prefix type:type node:node exact:YES error:error]) {
+            return NO;
+        }
+        for (NSUInteger i = 0; i < _alphabet.length; i++) {
+            NSString* longer = [prefix stringByAppendingString:[_alphabet substringWithRange:NSMakeRange(i, 1)]];
+            if (![self exportPrefix:longer type:type node:node exact:NO error:error]) {
+                return NO;
+            }
+        }
+        return YES;
+    }
+
+    [self exportRecords:records type:type attributes:attributes];
+    return YES;
+}
+
+/* Prefix shards only reach names built from the alphabet.  A RecordName only listing of the whole
+   type finds everything else, which is then read back by exact name.  A listed name that can't be
+   read back fails the pass, so an incomplete export never reports success. */
+- (BOOL)exportUncoveredType:(NSString*)type node:(ODNode*)node error:(NSError* __autoreleasing*)error
+{
+    if (![_job checkpoint] || [self writeFailed]) {
+        return YES;
+    }
+
+    NSMutableArray* missing = [NSMutableArray new];
+    @autoreleasepool
+    {
+        NSArray* listed = [self recordsOfType:type prefix:nil names:nil attributes:@[ kODAttributeTypeRecordName ] limit:0 node:node error:error];
+        if (!listed) {
+            return NO;
+        }
+        @synchronized(self)
+        {
+            NSSet* exported = _exportedNames[type];
+            for (ODRecord* record in listed) {
+                NSString* name = record.recordName;
+                if (name && ![exported containsObject:name]) {
+                    [missing addObject:name];
+                }
+            }
+        }
+    }
+
+    NSArray* attributes = [self attributesForType:type];
+    NSUInteger pageSize = _pageSize ? _pageSize : kODMExportDefaultPageSize;
+    for (NSUInteger i = 0; i < missing.count; i += pageSize) {
+        if (![_job checkpoint] || [self writeFailed]) {
+            return YES;
+        }
+        NSArray* names = [missing subarrayWithRange:NSMakeRange(i, MIN(pageSize, missing.count - i))];
+        NSArray* records = [self recordsOfType:type prefix:nil names:names attributes:attributes limit:0 node:node error:error];
+        if (!records) {
+            return NO;
+        }
+        [self exportRecords:records type:type attributes:attributes];
+    }
+
+    NSMutableArray* lost = [NSMutableArray new];
+    @synchronized(self)
+    {
+        NSSet* exported = _exportedNames[type];
+        for (NSString* name in missing) {
+            if (![exported containsObject:name]) {
+                [lost addObject:name];
+            }
+        }
+    }
+    if (lost.count) {
+        NSString* message = [NSString stringWithFormat:@"%lu %@ could not be read back and were not exported: %@",
+                                                       (unsigned long)lost.count, type,
+                                                       [[lost subarrayWithRange:NSMakeRange(0, MIN(10, lost.count))] componentsJoinedByString:@", "]];
+        return [ODManagerError errorWithMessage:message error:error];
+    }
+    return YES;
+}
+
+- (NSArray*)recordsOfType:(NSString*)type
+                   prefix:(NSString*)prefix
+                    names:(NSArray*)names
+               attributes:(NSArray*)attributes
+                    limit:(NSUInteger)limit
+                     node:(ODNode*)node
+                    error:(NSError* __autoreleasing*)error
+{
+    ODMatchType matchType = prefix ? kODMatchBeginsWith : (names ? kODMatchEqualTo : kODMatchAny);
+    id values = prefix ? prefix : names;
+    ODQuery* query = [ODQuery queryWithNode:node
+                             forRecordTypes:type
+                                  attribute:kODAttributeTypeRecordName
+                                  matchType:matchType
+                                queryValues:values
+                           returnAttributes:attributes ? attributes : kODAttributeTypeStandardOnly
+                             maximumResults:limit
+                                      error:error];
+    return [query resultsAllowingPartial:NO error:error];
+}
+
+/* A node that matches case insensitively can return a record from more than one read, each name is written once. */
+- (void)exportRecords:(NSArray*)records type:(NSString*)type attributes:(NSArray*)attributes
+{
+    NSMutableArray* fresh = [NSMutableArray arrayWithCapacity:records.count];
+    @synchronized(self)
+    {
+        NSMutableSet* exported = _exportedNames[type];
+        for (ODRecord* record in records) {
+            NSString* name = record.recordName;
+            if (name && ![exported containsObject:name]) {
+                [exported addObject:name];
+                [fresh addObject:record];
+            }
+        }
+    }
+    if (fresh.count) {
+        [self enqueuePage:[self pageForRecords:fresh type:type attributes:attributes] count:fresh.count];
+    }
+}
+
+#pragma mark - Formatting
+- (NSMutableData*)pageForRecords:(NSArray*)records type:(NSString*)type attributes:(NSArray*)attributes
+{
+    NSMutableData* page = [NSMutableData new];
+    NSData* newline = [@"\n" dataUsingEncoding:NSUTF8StringEncoding];
+    for (ODRecord* record in records) {
+        @autoreleasepool
+        {
+            NSDictionary* details = [record recordDetailsForAttributes:attributes ? attributes : @[ kODAttributeTypeStandardOnly ] error:nil];
+            if (_format == kODMExportDSImport) {
+                NSMutableArray* fields = [NSMutableArray arrayWithCapacity:attributes.count];
+                for (NSString* attribute in attributes) {
+                    NSMutableArray* values = [NSMutableArray new];
+                    for (id value in details[attribute]) {
+                        [values addObject:[[self class] escapeDSImportValue:[[self class] stringForValue:value]]];
+                    }
+                    [fields addObject:[values componentsJoinedByString:@","]];
+                }
+                [page appendData:[[fields componentsJoinedByString:@":"] dataUsingEncoding:NSUTF8StringEncoding]];
+            } else {
+                NSMutableDictionary* values = [NSMutableDictionary dictionaryWithCapacity:details.count];
+                [details enumerateKeysAndObjectsUsingBlock:^(NSString* attribute, NSArray* attributeValues, BOOL* stop) {
+                    NSMutableArray* strings = [NSMutableArray arrayWithCapacity:attributeValues.count];
+                    for (id value in attributeValues) {
+                        [strings addObject:[[self class] stringForValue:value]];
+                    }
+                    values[attribute] = strings;
+                }];
+                NSDictionary* line = @{ @"type" : type,
+                                        @"name" : record.recordName ? record.recordName : @"",
+                                        @"attributes" : values };
+                NSData* data = [NSJSONSerialization dataWithJSONObject:line options:0 error:nil];
+                if (!data) {
+                    continue;
+                }
+                [page appendData:data];
+            }
+            [page appendData:newline];
+        }
+    }
+    return page;
+}
+
+/* binary values such as pictures go out as base64 */
++ (NSString*)stringForValue:(id)value
+{
+    if ([value isKindOfClass:[NSString class]]) {
+        return value;
+    }
+    if ([value isKindOfClass:[NSData class]]) {
+        return [value respondsToSelector:@selector(base64EncodedStringWithOptions:)] ? [value base64EncodedStringWithOptions:0]
+                                                                                     : [value base64Encoding];
+    }
+    return [value description];
+}
+
++ (NSString*)escapeDSImportValue:(NSString*)value
+{
+    if ([value rangeOfCharacterFromSet:[NSCharacterSet characterSetWithCharactersInString:@"\\:,\n"]].location == NSNotFound) {
+        return value;
+    }
+    NSMutableString* escaped = [NSMutableString stringWithCapacity:value.length + 4];
+    for (NSUInteger i = 0; i < value.length; i++) {
+        unichar c = [value characterAtIndex:i];
+        if (c == '\\' || c == ':' || c == ',' || c == '\n') {
+            [escaped appendString:@"\\"];
+        }
+        [escaped appendFormat:@"%C", c];
+    }
+    return escaped;
+}
+
+#pragma mark - Writer
+/* Blocks while maxPendingPages are waiting, which holds the shard's query until the writer catches up. */
+- (void)enqueuePage:(NSData*)page count:(NSUInteger)count
+{
+    dispatch_semaphore_wait(_pendingPages, DISPATCH_TIME_FOREVER);
+    dispatch_semaphore_t pending = _pendingPages;
+    dispatch_async(_writerQueue, ^{
+        if (!_writeError) {
+            NSError* writeError;
+            if ([self write:page error:&writeError]) {
+                @synchronized(self)
+                {
+                    _exportedCount += count;
+                }
+            } else {
+                @synchronized(self)
+                {
+                    _writeError = writeError;
+                }
+            }
+        }
+        dispatch_semaphore_signal(pending);
+    });
+}
+
+- (BOOL)writeFailed
+{
+    @synchronized(self)
+    {
+        return _writeError != nil;
+    }
+}
+
+- (BOOL)write:(NSData*)data error:(NSError* __autoreleasing*)error
+{
+    const uint8_t* bytes = data.bytes;
+    NSUInteger remaining = data.length;
+    while (remaining > 0) {
+        NSInteger written = [_stream write:bytes maxLength:remaining];
+        if (written <= 0) {
+            if (_stream.streamError) {
+                if (error)
+                    *error = _stream.streamError;
+            } else {
+                [ODManagerError errorWithMessage:@"Could not write the export" error:error];
+            }
+            return NO;
+        }
+        bytes += written;
+        remaining -= written;
+    }
+    return YES;
+}
+
+@end
@@ -0,0 +1,150 @@
+//
+//  ODManagerJob.h
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+#import "ODManagerResult.h"
+
+typedef NS_ENUM(NSInteger, ODMJobState) {
+    kODMJobPending = 0,
+    kODMJobRunning,
+    kODMJobPaused,
+    kODMJobCanceled,
+    kODMJobFinished,
+};
+
+/**
+ *  Handle for a single bulk import or removal.
+ *  @discussion Every bulk operation gets its own job, so several imports can run at the same time without sharing callbacks or cancel flags.
+ */
+@interface ODManagerJob : NSObject
+
+/**
+ *  current state of the job
+ */
+@property (readonly) ODMJobState state;
+
+/**
+ *  number of records the job will process
+ */
+@property (readonly) NSUInteger total;
+
+/**
+ *  number of records processed so far, successful or not
+ */
+@property (readonly) NSUInteger completed;
+
+/**
+ *  percent complete x/100
+ */
+@property (readonly) double progress;
+
+/**
+ *  per record outcomes, use this rather than succeeded, failed and errors for large jobs
+ */
+@property (strong, readonly) ODManagerResult* result;
+
+/**
+ *  record names that were processed successfully
+ */
+@property (copy, readonly) NSArray* succeeded;
+
+/**
+ *  record names that failed
+ */
+@property (copy, readonly) NSArray* failed;
+
+/**
+ *  record name -> NSError for every record that failed
+ */
+@property (copy, readonly) NSDictionary* errors;
+
+/**
+ *  error the job finished with, nil on success
+ */
+@property (strong, readonly) NSError* error;
+
+/**
+ *  block that is called on the main queue each time a record is processed.  The block has no return value and takes two argument: record name and progress;
+ */
+@property (copy) void (^progressHandler)(NSString* message, double progress);
+
+/**
+ *  block that is called once when the job finishes or is canceled.  The block has no return value and takes one argument: NSError;
+ */
+@property (copy) void (^completionHandler)(NSError* error);
+
+@property (readonly, getter=isCancelled) BOOL cancelled;
+@property (readonly, getter=isFinished) BOOL finished;
+
+/**
+ *  Stop the job after the record currently being processed
+ */
+- (void)cancel;
+
+/**
+ *  Hold the job before the next record is processed
+ */
+- (void)pause;
+
+/**
+ *  Continue a paused job
+ */
+- (void)resume;
+
+/**
+ *  Block the calling thread until the job finishes
+ */
+- (void)waitUntilFinished;
+
+@end
+
+/**
+ *  Used by ODManagerEditor to drive the job
+ */
+@interface ODManagerJob (Runner)
+- (void)beginWithTotal:(NSUInteger)total;
+
+/**
+ *  called once, on the thread that calls cancel, for work that has to be stopped rather than waiting for a checkpoint
+ */
+@property (copy) void (^cancellationHandler)(void);
+
+/**
+ *  blocks while the job is paused
+ *
+ *  @return NO if the job has been canceled
+ */
+- (BOOL)checkpoint;
+
+/**
+ *  splits items into batches, each batch becomes one operation on the queue.
+ *  @discussion the block is called once per item and stops being called when the job is canceled.
+ */
+- (void)addBatchesOfItems:(NSArray*)items size:(NSUInteger)size toQueue:(NSOperationQueue*)queue block:(void (^)(id item))block;
+
+- (void)recordSuccess:(NSString*)record;
+- (void)recordFailure:(NSString*)record error:(NSError*)error;
+- (void)finishWithError:(NSError*)error;
+@end
@@ -0,0 +1,297 @@
+//
+//  ODManagerJob.m
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "ODManagerJob.h"
+#import "ODManagerError.h"
+
+@interface ODManagerJob ()
+@property (strong, readwrite) NSError* error;
+@end
+
+@implementation ODManagerJob {
+    NSCondition* _stateCondition;
+    ODMJobState _state;
+    NSUInteger _total;
+    NSUInteger _completed;
+    BOOL _finishing;
+    BOOL _completionSent;
+    void (^_cancellationHandler)(void);
+}
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        _stateCondition = [NSCondition new];
+        _result = [ODManagerResult new];
+        _state = kODMJobPending;
+    }
+    return self;
+}
+
+#pragma mark - Control
+- (void)cancel
+{
+    void (^cancellationHandler)(void);
+    [_stateCondition lock];
+    if (_state != kODMJobFinished && _state != kODMJobCanceled) {
+        _state = kODMJobCanceled;
+        cancellationHandler = _cancellationHandler;
+        _cancellationHandler = nil;
+    }
+    [_stateCondition broadcast];
+    [_stateCondition unlock];
+
+    if (cancellationHandler) {
+        cancellationHandler();
+    }
+}
+
+- (void)pause
+{
+    [_stateCondition lock];
+    if (_state == kODMJobRunning || _state == kODMJobPending) {
+        _state = kODMJobPaused;
+    }
+    [_stateCondition unlock];
+}
+
+- (void)resume
+{
+    [_stateCondition lock];
+    if (_state == kODMJobPaused) {
+        _state = kODMJobRunning;
+    }
+    [_stateCondition broadcast];
+    [_stateCondition unlock];
+}
+
+- (void)waitUntilFinished
+{
+    [_stateCondition lock];
+    while (!_completionSent) {
+        [_stateCondition wait];
+    }
+    [_stateCondition unlock];
+}
+
+#pragma mark - State
+- (ODMJobState)state
+{
+    [_stateCondition lock];
+    ODMJobState state = _state;
+    [_stateCondition unlock];
+    return state;
+}
+
+- (BOOL)isCancelled
+{
+    return self.state == kODMJobCanceled;
+}
+
+- (BOOL)isFinished
+{
+    [_stateCondition lock];
+    BOOL finished = _completionSent;
+    [_stateCondition unlock];
+    return finished;
+}
+
+- (NSUInteger)total
+{
+    @synchronized(self)
+    {
+        return _total;
+    }
+}
+
+- (NSUInteger)completed
+{
+    @synchronized(self)
+    {
+        return _completed;
+    }
+}
+
+- (double)progress
+{
+    @synchronized(self)
+    {
+        return _total ? ((double)_completed / _total * 100) : 0.0;
+    }
+}
+
+- (NSArray*)succeeded
+{
+    return [_result succeededNames];
+}
+
+- (NSArray*)failed
+{
+    return [_result failedNames];
+}
+
+- (NSDictionary*)errors
+{
+    NSMutableDictionary* errors = [NSMutableDictionary new];
+    NSUInteger count = _result.count;
+    for (NSUInteger i = 0; i < count; i++) {
+        NSError* error = [_result errorAtIndex:i];
+        if (error) {
+            errors[[_result nameAtIndex:i]] = error;
+        }
+    }
+    return errors;
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"ODManagerJob - %lu/%lu succeeded:%lu failed:%lu",
+                                      (unsigned long)self.completed, (unsigned long)self.total,
+                                      (unsigned long)_result.successCount, (unsigned long)_result.failureCount];
+}
+
+@end
+
+#pragma mark - Runner
+@implementation ODManagerJob (Runner)
+
+- (void)beginWithTotal:(NSUInteger)total
+{
+    @synchronized(self)
+    {
+        _total = total;
+    }
+    [_stateCondition lock];
+    if (_state == kODMJobPending) {
+        _state = kODMJobRunning;
+    }
+    [_stateCondition unlock];
+}
+
+- (void (^)(void))cancellationHandler
+{
+    [_stateCondition lock];
+    void (^cancellationHandler)(void) = _cancellationHandler;
+    [_stateCondition unlock];
+    return cancellationHandler;
+}
+
+- (void)setCancellationHandler:(void (^)(void))cancellationHandler
+{
+    [_stateCondition lock];
+    _cancellationHandler = [cancellationHandler copy];
+    [_stateCondition unlock];
+}
+
+- (BOOL)checkpoint
+{
+    [_stateCondition lock];
+    while (_state == kODMJobPaused) {
+        [_stateCondition wait];
+    }
+    BOOL rc = (_state != kODMJobCanceled);
+    [_stateCondition unlock];
+    return rc;
+}
+
+- (void)addBatchesOfItems:(NSArray*)items size:(NSUInteger)size toQueue:(NSOperationQueue*)queue block:(void (^)(id item))block
+{
+    size = size ? size : 1;
+    for (NSUInteger i = 0; i < items.count; i += size) {
+        NSArray* batch = [items subarrayWithRange:NSMakeRange(i, MIN(size, items.count - i))];
+        [queue addOperationWithBlock:^{
+            for (id item in batch) {
+                if (![self checkpoint]) {
+                    return;
+                }
+                @autoreleasepool
+                {
+                    block(item);
+                }
+            }
+        }];
+    }
+}
+
+- (void)recordSuccess:(NSString*)record
+{
+    [self recordResult:record success:YES error:nil];
+}
+
+- (void)recordFailure:(NSString*)record error:(NSError*)error
+{
+    [self recordResult:record success:NO error:error];
+}
+
+- (void)recordResult:(NSString*)record success:(BOOL)success error:(NSError*)error
+{
+    double progress;
+    @synchronized(self)
+    {
+        if (record) {
+            if (!success && !error) {
+                [ODManagerError errorWithMessage:nil code:-1 error:&error];
+            }
+            [_result addName:record error:success ? nil : error];
+        }
+        _completed++;
+        progress = _total ? ((double)_completed / _total * 100) : 0.0;
+    }
+
+    void (^progressHandler)(NSString*, double) = self.progressHandler;
+    if (progressHandler) {
+        [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+            progressHandler(record, progress);
+        }];
+    }
+}
+
+- (void)finishWithError:(NSError*)error
+{
+    [_stateCondition lock];
+    if (_finishing) {
+        [_stateCondition unlock];
+        return;
+    }
+    _finishing = YES;
+    if (_state != kODMJobCanceled) {
+        _state = kODMJobFinished;
+    }
+    _cancellationHandler = nil;
+    [_stateCondition unlock];
+
+    self.error = error;
+    if (self.completionHandler) {
+        self.completionHandler(error);
+    }
+
+    [_stateCondition lock];
+    _completionSent = YES;
+    [_stateCondition broadcast];
+    [_stateCondition unlock];
+}
+
+@end
@@ -0,0 +1,91 @@
+//
+//  ODManagerJournal.h
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+typedef NS_OPTIONS(NSUInteger, ODMJournalStage) {
+    kODMJournalCreated = 1 << 0,
+    kODMJournalPasswordSet = 1 << 1,
+    kODMJournalMemberAdded = 1 << 2,
+    kODMJournalCreating = 1 << 3,
+    kODMJournalExisted = 1 << 4,
+};
+
+/**
+ *  Append-only on-disk log of the per record stages a bulk job has finished.
+ *  @discussion entries are buffered and written with one fsync per syncInterval entries, so a crash loses at most the last unsynced batch and that work is simply redone.  Opening an existing journal loads what was already done so a rerun of the same job can skip it.
+ */
+@interface ODManagerJournal : NSObject
+
+@property (copy, readonly) NSString* path;
+
+/**
+ *  number of entries buffered before they are written and synced to disk. Defaults to 128
+ */
+@property NSUInteger syncInterval;
+
+/**
+ *  number of stages that were already in the journal when it was opened
+ */
+@property (readonly) NSUInteger resumedCount;
+
+- (id)initWithPath:(NSString*)path;
+
+/**
+ *  Load any existing entries and open the file for appending
+ *
+ *  @param error populated should error occur
+ *
+ *  @return YES for success, NO on failure.
+ */
+- (BOOL)open:(NSError**)error;
+
+/**
+ *  Write and sync anything buffered, then close the file
+ */
+- (void)close;
+
+/**
+ *  Write and sync anything buffered
+ *
+ *  @param error populated should error occur
+ *
+ *  @return YES for success, NO on failure.
+ */
+- (BOOL)synchronize:(NSError**)error;
+
+- (void)markStage:(ODMJournalStage)stage forRecord:(NSString*)name;
+- (BOOL)hasCompletedStage:(ODMJournalStage)stage forRecord:(NSString*)name;
+
+/**
+ *  whether the stage was already in the journal when it was opened, stages marked since don't count
+ *  @discussion use this to tell work an earlier run started from work this run started
+ */
+- (BOOL)hadStageWhenOpened:(ODMJournalStage)stage forRecord:(NSString*)name;
+
+- (void)markUser:(NSString*)user addedToGroup:(NSString*)group;
+- (BOOL)hasAddedUser:(NSString*)user toGroup:(NSString*)group;
+
+@end
@@ -0,0 +1,252 @@
+//
+//  ODManagerJournal.m
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "ODManagerJournal.h"
+#import "ODManagerError.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+static NSUInteger const kODMDefaultJournalSyncInterval = 128;
+
+/* one line per entry: stage bits, a tab, the record name.  Membership entries name the group and user */
+static NSString* const kODMJournalLineFormat = @"%lu\t%@\n";
+
+@implementation ODManagerJournal {
+    int _fd;
+    NSMutableData* _buffer;
+    NSUInteger _buffered;
+    NSMutableDictionary* _stages; // record name -> NSNumber of ODMJournalStage bits
+    NSDictionary* _openedStages; // the same, as loaded by open:
+}
+
+- (id)init
+{
+    return [self initWithPath:nil];
+}
+
+- (id)initWithPath:(NSString*)path
+{
+    self = [super init];
+    if (self) {
+        _path = [path copy];
+        _fd = -1;
+        _syncInterval = kODMDefaultJournalSyncInterval;
+        _buffer = [NSMutableData new];
+        _stages = [NSMutableDictionary new];
+        _openedStages = @{};
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [self close];
+}
+
+#pragma mark - Open/Close
+- (BOOL)open:(NSError* __autoreleasing*)error
+{
+    @synchronized(self)
+    {
+        if (_fd >= 0) {
+            return YES;
+        }
+        if (!_path) {
+            return [ODManagerError errorWithMessage:@"No journal path supplied" error:error];
+        }
+
+        NSString* contents = [NSString stringWithContentsOfFile:_path encoding:NSUTF8StringEncoding error:nil];
+        [self loadContents:contents];
+        _openedStages = [_stages copy];
+
+        _fd = open(_path.fileSystemRepresentation, O_WRONLY | O_CREAT | O_APPEND, 0600);
+        if (_fd < 0) {
+            if (error)
+                *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+            return NO;
+        }
+
+        /* a crash can leave half a line behind.  Cut it off rather than ending it, a finished
+           fragment would read back as an entry for a truncated name */
+        if (contents.length && ![contents hasSuffix:@"\n"]) {
+            NSRange last = [contents rangeOfString:@"\n" options:NSBackwardsSearch];
+            NSUInteger kept = last.location == NSNotFound ? 0 : NSMaxRange(last);
+            off_t length = [[contents substringToIndex:kept] lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+            if (ftruncate(_fd, length) != 0) {
+                if (error)
+                    *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+                close(_fd);
+                _fd = -1;
+                return NO;
+            }
+        }
+    }
+    return YES;
+}
+
+- (void)loadContents:(NSString*)contents
+{
+    NSArray* lines = [contents componentsSeparatedByString:@"\n"];
+    /* the last piece is either empty or an unfinished line */
+    for (NSUInteger i = 0; i + 1 < lines.count; i++) {
+        NSString* line = lines[i];
+        NSRange tab = [line rangeOfString:@"\t"];
+        if (tab.location == NSNotFound) {
+            continue;
+        }
+        NSUInteger stage = (NSUInteger)[[line substringToIndex:tab.location] integerValue];
+        NSString* name = [line substringFromIndex:NSMaxRange(tab)];
+        if (stage && name.length) {
+            _stages[name] = @([_stages[name] unsignedIntegerValue] | stage);
+            _resumedCount++;
+        }
+    }
+}
+
+- (void)close
+{
+    @synchronized(self)
+    {
+        if (_fd < 0) {
+            return;
+        }
+        NSError* error;
+        if (![self flush:&error]) {
+            [ODManagerError logError:error];
+        }
+        close(_fd);
+        _fd = -1;
+    }
+}
+
+#pragma mark - Sync
+- (BOOL)synchronize:(NSError* __autoreleasing*)error
+{
+    @synchronized(self)
+    {
+        return [self flush:error];
+    }
+}
+
+/* caller holds the lock */
+- (BOOL)flush:(NSError* __autoreleasing*)error
+{
+    if (_fd < 0 || !_buffered) {
+        return YES;
+    }
+
+    const char* bytes = _buffer.bytes;
+    size_t remaining = _buffer.length;
+    while (remaining > 0) {
+        ssize_t written = write(_fd, bytes, remaining);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (error)
+                *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+            return NO;
+        }
+        bytes += written;
+        remaining -= written;
+    }
+    if (fsync(_fd) != 0) {
+        if (error)
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        return NO;
+    }
+
+    _buffer.length = 0;
+    _buffered = 0;
+    return YES;
+}
+
+#pragma mark - Stages
+- (void)markStage:(ODMJournalStage)stage forRecord:(NSString*)name
+{
+    if (!name) {
+        return;
+    }
+    @synchronized(self)
+    {
+        _stages[name] = @([_stages[name] unsignedIntegerValue] | stage);
+        if (_fd < 0) {
+            return;
+        }
+
+        NSString* line = [NSString stringWithFormat:kODMJournalLineFormat, (unsigned long)stage, name];
+        [_buffer appendData:[line dataUsingEncoding:NSUTF8StringEncoding]];
+        if (++_buffered >= _syncInterval) {
+            NSError* error;
+            if (![self flush:&error]) {
+                [ODManagerError logError:error];
+            }
+        }
+    }
+}
+
+- (BOOL)hasCompletedStage:(ODMJournalStage)stage forRecord:(NSString*)name
+{
+    if (!name) {
+        return NO;
+    }
+    @synchronized(self)
+    {
+        return ([_stages[name] unsignedIntegerValue] & stage) == stage;
+    }
+}
+
+- (BOOL)hadStageWhenOpened:(ODMJournalStage)stage forRecord:(NSString*)name
+{
+    if (!name) {
+        return NO;
+    }
+    @synchronized(self)
+    {
+        return ([_openedStages[name] unsignedIntegerValue] & stage) == stage;
+    }
+}
+
+- (NSString*)nameForUser:(NSString*)user group:(NSString*)group
+{
+    return [NSString stringWithFormat:@"%@\t%@", group, user];
+}
+
+- (void)markUser:(NSString*)user addedToGroup:(NSString*)group
+{
+    if (user && group) {
+        [self markStage:kODMJournalMemberAdded forRecord:[self nameForUser:user group:group]];
+    }
+}
+
+- (BOOL)hasAddedUser:(NSString*)user toGroup:(NSString*)group
+{
+    if (!user || !group) {
+        return NO;
+    }
+    return [self hasCompletedStage:kODMJournalMemberAdded forRecord:[self nameForUser:user group:group]];
+}
+
+@end
@@ -29,6 +29,7 @@
 @interface ODManagerNode : NSObject
 @property (weak) id<ODManagerDelegate> delegate;
 @property (strong) ODNode* node;
+@property (strong) ODSession* session;
 @property (copy) NSString* server;
 @property int domain;
 @property int status;
@@ -40,4 +41,66 @@
 
 - (OSStatus)authenticateWithUser:(NSString*)user password:(NSString*)password error:(NSError**)error;
 
+/**
+ *  Open another connection to the same node, so independent work doesn't queue behind a single handle
+ *
+ *  @param user     user to authenticate the new handle as, nil to leave it unauthenticated
+ *  @param password password for the user
+ *  @param error    populated should error occur
+ *
+ *  @return new node, nil on failure
+ */
+- (ODNode*)openNodeHandleWithUser:(NSString*)user password:(NSString*)password error:(NSError**)error;
+
+
+/**
+ *  Open a different node on the same session
+ *
+ *  @param name  node name such as /LDAPv3/replica.example.com, or just the server address
+ *  @param error populated should error occur
+ *
+ *  @return node, nil on failure
+ */
+- (ODNode*)openNodeNamed:(NSString*)name error:(NSError**)error;
+
+/**
+ *  A new node manager on the same session with a handle of its own, so it can be authenticated without touching this one
+ *
+ *  @param error populated should error occur
+ *
+ *  @return unauthenticated node manager, nil on failure
+ */
+- (ODManagerNode*)nodeManagerWithNewHandle:(NSError**)error;
+
+@end
+
+/**
+ *  Immutable view of the connection that ODManager publishes and swaps as a whole.
+ *  @discussion callers read the current snapshot and use its node for the whole call.  A node manager is never authenticated or reconnected once it has been published; authenticating builds a new one on a new handle, so a reconnect never changes a snapshot that is already in use.
+ */
+@interface ODConnectionState : NSObject
+
+@property (strong, readonly) ODManagerNode* nodeManager;
+@property (strong, readonly) ODNode* node;
+@property (readonly) BOOL authenticated;
+@property (readonly) int status;
+
+/**
+ *  why the attempt that published this snapshot failed, nil if it succeeded.  Callers that queued behind the attempt get this error rather than trying again themselves
+ */
+@property (strong, readonly) NSError* error;
+
+/**
+ *  increases by one each time a new snapshot is published
+ */
+@property (readonly) NSUInteger generation;
+
+/**
+ *  when the snapshot was published, as seconds since the reference date
+ */
+@property (readonly) NSTimeInterval timestamp;
+
+- (id)initWithNodeManager:(ODManagerNode*)nodeManager authenticated:(BOOL)authenticated generation:(NSUInteger)generation;
+- (id)initWithNodeManager:(ODManagerNode*)nodeManager authenticated:(BOOL)authenticated generation:(NSUInteger)generation error:(NSError*)error;
+
 @end
@@ -81,6 +81,7 @@
             _status = kODMNodeNotAutenticatedProxy;
             return NO;
         }
+        _session = session;
         _node = [ODNode nodeWithSession:session name:@"/LDAPv3/127.0.0.1" error:&err];
         if (_node) {
             [_delegate didRecieveStatusUpdate:kODMNodeAuthenticatedProxy];
@@ -97,6 +98,7 @@
         return NO;
     }
 
+    _session = session;
     NSString* ds;
     if (_server) {
         if ([_server rangeOfString:@"LDAPv3"].location == NSNotFound) {
@@ -149,4 +151,87 @@
     return _status;
 }
 
+- (ODNode*)openNodeHandleWithUser:(NSString*)user password:(NSString*)password error:(NSError* __autoreleasing*)error
+{
+    if (!_node || !_session) {
+        [ODManagerError errorWithCode:kODMerrNoDirectoryNode error:error];
+        return nil;
+    }
+
+    ODNode* node = [ODNode nodeWithSession:_session name:_node.nodeName error:error];
+    if (!node) {
+        return nil;
+    }
+
+    /* proxy sessions are authenticated by the session itself */
+    if (user && password && _domain != kODMProxyDirectoryServer) {
+        if (![node setCredentialsWithRecordType:nil recordName:user password:password error:error]) {
+            return nil;
+        }
+    }
+    return node;
+}
+
+- (ODNode*)openNodeNamed:(NSString*)name error:(NSError* __autoreleasing*)error
+{
+    ODSession* session = _session ? _session : [ODSession defaultSession];
+    if (!name || !session) {
+        [ODManagerError errorWithCode:kODMerrNoDirectoryNode error:error];
+        return nil;
+    }
+    if (![name hasPrefix:@"/"]) {
+        name = [NSString stringWithFormat:@"/LDAPv3/%@", name];
+    }
+    return [ODNode nodeWithSession:session name:name error:error];
+}
+
+- (ODManagerNode*)nodeManagerWithNewHandle:(NSError* __autoreleasing*)error
+{
+    ODNode* node = [self openNodeHandleWithUser:nil password:nil error:error];
+    if (!node) {
+        return nil;
+    }
+    ODManagerNode* nodeManager = [[ODManagerNode alloc] initWithServer:_server domain:_domain];
+    nodeManager.delegate = _delegate;
+    nodeManager.session = _session;
+    nodeManager.node = node;
+    nodeManager.status = (_domain != kODMProxyDirectoryServer) ? kODMNodeNotAuthenticatedLocal : kODMNodeNotAutenticatedProxy;
+    return nodeManager;
+}
+
+@end
+
+@implementation ODConnectionState
+
+- (id)init
+{
+    return [self initWithNodeManager:nil authenticated:NO generation:0];
+}
+
+- (id)initWithNodeManager:(ODManagerNode*)nodeManager authenticated:(BOOL)authenticated generation:(NSUInteger)generation
+{
+    return [self initWithNodeManager:nodeManager authenticated:authenticated generation:generation error:nil];
+}
+
+- (id)initWithNodeManager:(ODManagerNode*)nodeManager authenticated:(BOOL)authenticated generation:(NSUInteger)generation error:(NSError*)error
+{
+    self = [super init];
+    if (self) {
+        _error = error;
+        _nodeManager = nodeManager;
+        _node = nodeManager.node;
+        _status = nodeManager.status;
+        _authenticated = authenticated;
+        _generation = generation;
+        _timestamp = [NSDate timeIntervalSinceReferenceDate];
+    }
+    return self;
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"ODConnectionState - generation:%lu node:%@ authenticated:%d",
+                                      (unsigned long)_generation, _node.nodeName, _authenticated];
+}
+
 @end
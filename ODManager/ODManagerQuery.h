@@ -0,0 +1,122 @@
+//
+//  ODManagerQuery.h
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+@class ODNode, ODQuery;
+
+/**
+ *  How a predicate compares an attribute value
+ *  @discussion kODMMatchGreaterThan and kODMMatchLessThan order values as case insensitive strings, the way the node does, whether the test runs on the server or on the client.  Numbers are not compared numerically, "100" is less than "20", so ids and timestamps only order correctly when they have the same number of digits.
+ */
+typedef NS_ENUM(NSInteger, ODMMatchType) {
+    kODMMatchEqualTo = 0,
+    kODMMatchBeginsWith,
+    kODMMatchEndsWith,
+    kODMMatchContains,
+    kODMMatchGreaterThan,
+    kODMMatchLessThan,
+    kODMMatchPresent,
+};
+
+/**
+ *  Attribute test, or an AND/OR of other predicates
+ */
+@interface ODManagerPredicate : NSObject
+
++ (ODManagerPredicate*)attribute:(NSString*)attribute matches:(ODMMatchType)match value:(NSString*)value;
++ (ODManagerPredicate*)attribute:(NSString*)attribute equals:(NSString*)value;
++ (ODManagerPredicate*)and:(NSArray*)predicates;
++ (ODManagerPredicate*)or:(NSArray*)predicates;
+
+/**
+ *  every attribute the predicate tests
+ */
+@property (copy, readonly) NSSet* attributes;
+
+/**
+ *  LDAP style filter string, as used by kODMatchCompoundExpression queries
+ */
+- (NSString*)filterString;
+
+/**
+ *  Test a record on the client
+ *
+ *  @param values dictionary of attribute -> array of values
+ *
+ *  @return whether the record matches, string comparisons ignore case and greater/less than order as strings, the same as the server
+ */
+- (BOOL)evaluateWithValues:(NSDictionary*)values;
+
+@end
+
+/**
+ *  Query that filters on the server.
+ *  @discussion a single test, or an OR of tests on one attribute with the same match type, becomes a plain ODQuery.  Anything else is sent as a compound expression, and if the node refuses it the records are read with only the needed attributes and filtered on the client.
+ */
+@interface ODManagerQuery : NSObject
+
+/**
+ *  record type to search, defaults to kODRecordTypeUsers
+ */
+@property (copy) NSString* recordType;
+
+/**
+ *  predicate records must match, nil for every record
+ */
+@property (strong) ODManagerPredicate* predicate;
+
+/**
+ *  attributes to return with each record, nil for the standard set
+ */
+@property (copy) NSArray* returnAttributes;
+
+/**
+ *  maximum number of records, 0 for no limit
+ */
+@property NSUInteger limit;
+
++ (ODManagerQuery*)queryForType:(NSString*)recordType predicate:(ODManagerPredicate*)predicate;
+
+/**
+ *  Native query for the node
+ *
+ *  @param node  node to query
+ *  @param error populated should error occur
+ *
+ *  @return ODQuery, nil if the node can't build it
+ */
+- (ODQuery*)queryWithNode:(ODNode*)node error:(NSError**)error;
+
+/**
+ *  Run the query
+ *
+ *  @param node  node to query
+ *  @param error populated should error occur
+ *
+ *  @return array of dictionaries of attribute -> array of values, with the record name under kODAttributeTypeRecordName
+ */
+- (NSArray*)resultsWithNode:(ODNode*)node error:(NSError**)error;
+
+@end
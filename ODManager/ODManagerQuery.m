@@ -0,0 +1,426 @@
+//
+//  ODManagerQuery.m
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "ODManagerQuery.h"
+#import "ODManagerError.h"
+#import <OpenDirectory/OpenDirectory.h>
+
+typedef NS_ENUM(NSInteger, ODMPredicateKind) {
+    kODMPredicateTest = 0,
+    kODMPredicateAnd,
+    kODMPredicateOr,
+};
+
+@interface ODManagerPredicate ()
+- (BOOL)nativeAttribute:(NSString**)attribute matchType:(ODMatchType*)matchType values:(NSArray**)values;
+@end
+
+@implementation ODManagerPredicate {
+    ODMPredicateKind _kind;
+    NSString* _attribute;
+    ODMMatchType _match;
+    NSString* _value;
+    NSArray* _predicates;
+}
+
++ (ODManagerPredicate*)attribute:(NSString*)attribute matches:(ODMMatchType)match value:(NSString*)value
+{
+    ODManagerPredicate* predicate = [ODManagerPredicate new];
+    predicate->_kind = kODMPredicateTest;
+    predicate->_attribute = [attribute copy];
+    predicate->_match = match;
+    predicate->_value = [value copy];
+    return predicate;
+}
+
++ (ODManagerPredicate*)attribute:(NSString*)attribute equals:(NSString*)value
+{
+    return [self attribute:attribute matches:kODMMatchEqualTo value:value];
+}
+
++ (ODManagerPredicate*)and:(NSArray*)predicates
+{
+    return [self compound:kODMPredicateAnd predicates:predicates];
+}
+
++ (ODManagerPredicate*)or:(NSArray*)predicates
+{
+    return [self compound:kODMPredicateOr predicates:predicates];
+}
+
++ (ODManagerPredicate*)compound:(ODMPredicateKind)kind predicates:(NSArray*)predicates
+{
+    ODManagerPredicate* predicate = [ODManagerPredicate new];
+    predicate->_kind = kind;
+    predicate->_predicates = [predicates copy];
+    return predicate;
+}
+
+- (NSSet*)attributes
+{
+    if (_kind == kODMPredicateTest) {
+        return _attribute ? [NSSet setWithObject:_attribute] : [NSSet set];
+    }
+    NSMutableSet* attributes = [NSMutableSet new];
+    for (ODManagerPredicate* predicate in _predicates) {
+        [attributes unionSet:predicate.attributes];
+    }
+    return attributes;
+}
+
+#pragma mark - Native
+/* a single test, or an OR of tests on one attribute with one match type, fits a plain ODQuery */
+- (BOOL)nativeAttribute:(NSString* __autoreleasing*)attribute matchType:(ODMatchType*)matchType values:(NSArray* __autoreleasing*)values
+{
+    if (_kind == kODMPredicateTest) {
+        ODMatchType type = [[self class] nativeMatchType:_match];
+        if (!type || !_attribute || !_value) {
+            return NO;
+        }
+        *attribute = _attribute;
+        *matchType = type;
+        *values = @[ _value ];
+        return YES;
+    }
+
+    if (_predicates.count == 1) {
+        return [_predicates[0] nativeAttribute:attribute matchType:matchType values:values];
+    }
+    if (_kind != kODMPredicateOr || !_predicates.count) {
+        return NO;
+    }
+
+    NSMutableArray* allValues = [NSMutableArray new];
+    for (ODManagerPredicate* predicate in _predicates) {
+        NSString* childAttribute;
+        ODMatchType childType;
+        NSArray* childValues;
+        if (![predicate nativeAttribute:&childAttribute matchType:&childType values:&childValues]) {
+            return NO;
+        }
+        if (allValues.count && (![childAttribute isEqualToString:*attribute] || childType != *matchType)) {
+            return NO;
+        }
+        *attribute = childAttribute;
+        *matchType = childType;
+        [allValues addObjectsFromArray:childValues];
+    }
+    *values = allValues;
+    return YES;
+}
+
++ (ODMatchType)nativeMatchType:(ODMMatchType)match
+{
+    switch (match) {
+    case kODMMatchEqualTo:
+        return kODMatchEqualTo;
+    case kODMMatchBeginsWith:
+        return kODMatchBeginsWith;
+    case kODMMatchEndsWith:
+        return kODMatchEndsWith;
+    case kODMMatchContains:
+        return kODMatchContains;
+    case kODMMatchGreaterThan:
+        return kODMatchGreaterThan;
+    case kODMMatchLessThan:
+        return kODMatchLessThan;
+    default:
+        return 0;
+    }
+}
+
+#pragma mark - Filter String
+- (NSString*)filterString
+{
+    if (_kind != kODMPredicateTest) {
+        NSMutableString* filter = [NSMutableString stringWithString:_kind == kODMPredicateAnd ? @"(&" : @"(|"];
+        for (ODManagerPredicate* predicate in _predicates) {
+            [filter appendString:[predicate filterString]];
+        }
+        [filter appendString:@")"];
+        return filter;
+    }
+
+    NSString* value = [[self class] escapedValue:_value];
+    switch (_match) {
+    case kODMMatchBeginsWith:
+        return [NSString stringWithFormat:@"(%@=%@*)", _attribute, value];
+    case kODMMatchEndsWith:
+        return [NSString stringWithFormat:@"(%@=*%@)", _attribute, value];
+    case kODMMatchContains:
+        return [NSString stringWithFormat:@"(%@=*%@*)", _attribute, value];
+    case kODMMatchGreaterThan:
+        return [NSString stringWithFormat:@"(&(%@>=%@)(!(%@=%@)))", _attribute, value, _attribute, value];
+    case kODMMatchLessThan:
+        return [NSString stringWithFormat:@"(&(%@<=%@)(!(%@=%@)))", _attribute, value, _attribute, value];
+    case kODMMatchPresent:
+        return [NSString stringWithFormat:@"(%@=*)", _attribute];
+    default:
+        return [NSString stringWithFormat:@"(%@=%@)", _attribute, value];
+    }
+}
+
+/* RFC 4515 escapes */
++ (NSString*)escapedValue:(NSString*)value
+{
+    if (!value) {
+        return @"";
+    }
+    NSMutableString* escaped = [NSMutableString stringWithCapacity:value.length];
+    for (NSUInteger i = 0; i < value.length; i++) {
+        unichar c = [value characterAtIndex:i];
+        switch (c) {
+        case '*':
+            [escaped appendString:@"\\2a"];
+            break;
+        case '(':
+            [escaped appendString:@"\\28"];
+            break;
+        case ')':
+            [escaped appendString:@"\\29"];
+            break;
+        case '\\':
+            [escaped appendString:@"\\5c"];
+            break;
+        case 0:
+            [escaped appendString:@"\\00"];
+            break;
+        default:
+            [escaped appendFormat:@"%C", c];
+        }
+    }
+    return escaped;
+}
+
+#pragma mark - Client Evaluation
+- (BOOL)evaluateWithValues:(NSDictionary*)values
+{
+    if (_kind == kODMPredicateAnd) {
+        for (ODManagerPredicate* predicate in _predicates) {
+            if (![predicate evaluateWithValues:values]) {
+                return NO;
+            }
+        }
+        return YES;
+    }
+    if (_kind == kODMPredicateOr) {
+        for (ODManagerPredicate* predicate in _predicates) {
+            if ([predicate evaluateWithValues:values]) {
+                return YES;
+            }
+        }
+        return NO;
+    }
+
+    id found = values[_attribute];
+    NSArray* recordValues = [found isKindOfClass:[NSArray class]] ? found : (found ? @[ found ] : @[]);
+    if (_match == kODMMatchPresent) {
+        return recordValues.count > 0;
+    }
+    for (id recordValue in recordValues) {
+        if ([recordValue isKindOfClass:[NSString class]] && [self value:recordValue matches:_value]) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
+- (BOOL)value:(NSString*)recordValue matches:(NSString*)value
+{
+    switch (_match) {
+    case kODMMatchBeginsWith:
+        return [recordValue rangeOfString:value options:NSCaseInsensitiveSearch | NSAnchoredSearch].location != NSNotFound;
+    case kODMMatchEndsWith:
+        return [recordValue rangeOfString:value options:NSCaseInsensitiveSearch | NSAnchoredSearch | NSBackwardsSearch].location != NSNotFound;
+    case kODMMatchContains:
+        return [recordValue rangeOfString:value options:NSCaseInsensitiveSearch].location != NSNotFound;
+    case kODMMatchGreaterThan:
+        return [recordValue compare:value options:NSCaseInsensitiveSearch] == NSOrderedDescending;
+    case kODMMatchLessThan:
+        return [recordValue compare:value options:NSCaseInsensitiveSearch] == NSOrderedAscending;
+    default:
+        return [recordValue caseInsensitiveCompare:value] == NSOrderedSame;
+    }
+}
+
+- (NSString*)description
+{
+    return [self filterString];
+}
+
+@end
+
+@implementation ODManagerQuery
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        _recordType = kODRecordTypeUsers;
+    }
+    return self;
+}
+
++ (ODManagerQuery*)queryForType:(NSString*)recordType predicate:(ODManagerPredicate*)predicate
+{
+    ODManagerQuery* query = [ODManagerQuery new];
+    query.recordType = recordType;
+    query.predicate = predicate;
+    return query;
+}
+
+- (id)fetchAttributes
+{
+    return _returnAttributes ? _returnAttributes : kODAttributeTypeStandardOnly;
+}
+
+- (BOOL)isNative
+{
+    NSString* attribute;
+    ODMatchType matchType;
+    NSArray* values;
+    return !_predicate || [_predicate nativeAttribute:&attribute matchType:&matchType values:&values];
+}
+
+- (ODQuery*)queryWithNode:(ODNode*)node error:(NSError* __autoreleasing*)error
+{
+    if (!node) {
+        [ODManagerError errorWithCode:kODMerrNoDirectoryNode error:error];
+        return nil;
+    }
+
+    NSString* attribute = kODAttributeTypeRecordName;
+    ODMatchType matchType = kODMatchAny;
+    NSArray* nativeValues;
+    id values = nil;
+
+    if (_predicate) {
+        if ([_predicate nativeAttribute:&attribute matchType:&matchType values:&nativeValues]) {
+            values = nativeValues;
+        } else {
+            attribute = nil;
+            matchType = kODMatchCompoundExpression;
+            values = [_predicate filterString];
+        }
+    }
+
+    return [ODQuery queryWithNode:node
+                   forRecordTypes:_recordType
+                        attribute:attribute
+                        matchType:matchType
+                      queryValues:values
+                 returnAttributes:[self fetchAttributes]
+                   maximumResults:_limit
+                            error:error];
+}
+
+- (NSArray*)resultsWithNode:(ODNode*)node error:(NSError* __autoreleasing*)error
+{
+    NSError* err;
+    ODQuery* query = [self queryWithNode:node error:&err];
+    NSArray* records = [query resultsAllowingPartial:NO error:&err];
+    if (records) {
+        return [self detailsForRecords:records attributes:_returnAttributes filter:nil];
+    }
+
+    if (!node || !_predicate || [self isNative]) {
+        if (error)
+            *error = err;
+        return nil;
+    }
+
+    /* the node wouldn't take the compound expression, filter on this side instead */
+    NSMutableSet* attributes = [_predicate.attributes mutableCopy];
+    [attributes addObject:kODAttributeTypeRecordName];
+    if (_returnAttributes) {
+        [attributes addObjectsFromArray:_returnAttributes];
+    }
+    query = [ODQuery queryWithNode:node
+                    forRecordTypes:_recordType
+                         attribute:kODAttributeTypeRecordName
+                         matchType:kODMatchAny
+                       queryValues:nil
+                  returnAttributes:_returnAttributes ? attributes.allObjects : kODAttributeTypeStandardOnly
+                    maximumResults:0
+                             error:&err];
+    records = [query resultsAllowingPartial:NO error:&err];
+    if (!records) {
+        if (error)
+            *error = err;
+        return nil;
+    }
+    return [self detailsForRecords:records attributes:_returnAttributes filter:_predicate];
+}
+
+- (NSArray*)detailsForRecords:(NSArray*)records attributes:(NSArray*)attributes filter:(ODManagerPredicate*)filter
+{
+    /* only read what is returned or filtered on, nil asks the record for everything it holds */
+    NSArray* fetch = nil;
+    if (attributes) {
+        NSMutableSet* wanted = [NSMutableSet setWithArray:attributes];
+        [wanted addObject:kODAttributeTypeRecordName];
+        if (filter.attributes) {
+            [wanted unionSet:filter.attributes];
+        }
+        fetch = wanted.allObjects;
+    }
+    NSMutableArray* results = [NSMutableArray arrayWithCapacity:records.count];
+    for (ODRecord* record in records) {
+        @autoreleasepool
+        {
+            NSMutableDictionary* details = [[record recordDetailsForAttributes:fetch error:nil] mutableCopy];
+            if (!details) {
+                details = [NSMutableDictionary new];
+            }
+            if (record.recordName && !details[kODAttributeTypeRecordName]) {
+                details[kODAttributeTypeRecordName] = @[ record.recordName ];
+            }
+            if (filter && ![filter evaluateWithValues:details]) {
+                continue;
+            }
+            if (attributes) {
+                NSMutableDictionary* projected = [NSMutableDictionary dictionaryWithCapacity:attributes.count + 1];
+                for (NSString* attribute in [attributes arrayByAddingObject:kODAttributeTypeRecordName]) {
+                    if (details[attribute]) {
+                        projected[attribute] = details[attribute];
+                    }
+                }
+                details = projected;
+            }
+            [results addObject:details];
+        }
+        if (_limit && results.count >= _limit) {
+            break;
+        }
+    }
+    return results;
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"ODManagerQuery - %@ %@ limit:%lu", _recordType, _predicate ? [_predicate filterString] : @"(all)", (unsigned long)_limit];
+}
+
+@end
@@ -0,0 +1,134 @@
+//
+//  ODManagerReconciler.h
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+#import "ODSecureObjects.h"
+#import "ODManagerJob.h"
+@class ODNode, ODGIDAllocator;
+
+/**
+ *  The changes needed to bring the directory in line with a desired ODRecordList
+ */
+@interface ODReconcilePlan : NSObject
+/**
+ *  ODUser objects that don't exist yet
+ */
+@property (copy, readonly) NSArray* usersToCreate;
+/**
+ *  user record name -> dictionary of attribute -> values that differ.  Only attributes set on the ODUser are compared, so fields left empty in the desired list are never reset
+ */
+@property (copy, readonly) NSDictionary* userUpdates;
+/**
+ *  user record names to delete
+ */
+@property (copy, readonly) NSArray* usersToDelete;
+/**
+ *  ODUser objects missing a record name, first name or last name.  They are neither created, updated nor deleted, and are recorded as failures when the plan is applied
+ */
+@property (copy, readonly) NSArray* rejectedUsers;
+/**
+ *  ODGroup objects that don't exist yet
+ */
+@property (copy, readonly) NSArray* groupsToCreate;
+/**
+ *  group record names to delete
+ */
+@property (copy, readonly) NSArray* groupsToDelete;
+/**
+ *  group record name -> array of user record names to add
+ */
+@property (copy, readonly) NSDictionary* membersToAdd;
+/**
+ *  group record name -> array of user record names to remove
+ */
+@property (copy, readonly) NSDictionary* membersToRemove;
+
+/**
+ *  total number of record writes the plan will make
+ */
+@property (readonly) NSUInteger changeCount;
+@end
+
+/**
+ *  Diffs a desired ODRecordList against a single bulk read of the directory and applies only the differences
+ */
+@interface ODManagerReconciler : NSObject
+
+@property (strong) ODNode* node;
+
+/**
+ *  delete users that exist in the directory but not in the desired list. Defaults to NO
+ */
+@property BOOL deleteUnlistedUsers;
+
+/**
+ *  delete groups that exist in the directory but not in the desired list. Defaults to NO
+ */
+@property BOOL deleteUnlistedGroups;
+
+/**
+ *  record names that are never deleted, defaults to diradmin and root
+ */
+@property (copy) NSSet* protectedRecordNames;
+
+/**
+ *  group IDs new groups are given from, shared with the editors so concurrent creates never pick the same ID.  A private one is used when nil
+ */
+@property (strong) ODGIDAllocator* gidAllocator;
+
+/**
+ *  number of operations run against the node at once. Defaults to 4
+ */
+@property NSUInteger maxConcurrentOperations;
+
+/**
+ *  number of records handled by each operation. Defaults to 50
+ */
+@property NSUInteger batchSize;
+
+- (id)initWithNode:(ODNode*)node;
+
+/**
+ *  Read the current users and groups and work out what has to change
+ *
+ *  @param desired list of ODUser and ODGroup objects that should exist
+ *  @param error   populated should error occur
+ *
+ *  @return plan, nil if the directory could not be read
+ */
+- (ODReconcilePlan*)planForRecordList:(ODRecordList*)desired error:(NSError**)error;
+
+/**
+ *  Apply a plan in batches
+ *
+ *  @param plan  plan from planForRecordList:error:
+ *  @param job   job that gets per record results, may be nil
+ *  @param error populated with the last error should one occur
+ *
+ *  @return YES if every change was applied
+ */
+- (BOOL)applyPlan:(ODReconcilePlan*)plan job:(ODManagerJob*)job error:(NSError**)error;
+
+@end
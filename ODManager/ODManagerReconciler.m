@@ -0,0 +1,517 @@
+//
+//  ODManagerReconciler.m
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "ODManagerReconciler.h"
+#import "ODManagerRecord.h"
+#import "ODManagerEditor.h"
+#import "ODManagerError.h"
+#import "ODGIDAllocator.h"
+#import <OpenDirectory/OpenDirectory.h>
+
+static NSUInteger const kODMDefaultReconcileConcurrency = 4;
+static NSUInteger const kODMDefaultReconcileBatchSize = 50;
+static NSInteger const kODMFirstDirectoryID = 1025;
+
+@interface ODReconcilePlan ()
+@property (copy, readwrite) NSArray* usersToCreate;
+@property (copy, readwrite) NSDictionary* userUpdates;
+@property (copy, readwrite) NSArray* usersToDelete;
+@property (copy, readwrite) NSArray* rejectedUsers;
+@property (copy, readwrite) NSArray* groupsToCreate;
+@property (copy, readwrite) NSArray* groupsToDelete;
+@property (copy, readwrite) NSDictionary* membersToAdd;
+@property (copy, readwrite) NSDictionary* membersToRemove;
+
+/* group -> full desired membership for groups whose membership changes */
+@property (copy) NSDictionary* desiredMembership;
+/* user record name -> GUID for every user that exists before the plan runs */
+@property (copy) NSDictionary* userGUIDs;
+/* gids in use when the plan was made */
+@property (copy) NSSet* usedGIDs;
+@end
+
+@implementation ODReconcilePlan
+- (NSUInteger)changeCount
+{
+    return _usersToCreate.count + _userUpdates.count + _usersToDelete.count + _groupsToCreate.count + _groupsToDelete.count + _desiredMembership.count;
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"ODReconcilePlan - users create:%lu update:%lu delete:%lu groups create:%lu delete:%lu membership:%lu",
+                                      (unsigned long)_usersToCreate.count, (unsigned long)_userUpdates.count,
+                                      (unsigned long)_usersToDelete.count, (unsigned long)_groupsToCreate.count,
+                                      (unsigned long)_groupsToDelete.count, (unsigned long)_desiredMembership.count];
+}
+@end
+
+@implementation ODManagerReconciler
+
+- (id)init
+{
+    return [self initWithNode:nil];
+}
+
+- (id)initWithNode:(ODNode*)node
+{
+    self = [super init];
+    if (self) {
+        _node = node;
+        _maxConcurrentOperations = kODMDefaultReconcileConcurrency;
+        _batchSize = kODMDefaultReconcileBatchSize;
+        _protectedRecordNames = [NSSet setWithObjects:@"diradmin", @"root", nil];
+    }
+    return self;
+}
+
+#pragma mark - Plan
++ (NSArray*)userAttributes
+{
+    return @[ kODAttributeTypeRecordName,
+              kODAttributeTypeGUID,
+              kODAttributeTypeFirstName,
+              kODAttributeTypeLastName,
+              kODAttributeTypeFullName,
+              kODAttributeTypeUniqueID,
+              kODAttributeTypePrimaryGroupID,
+              kODAttributeTypeUserShell,
+              kODAttributeTypeNFSHomeDirectory,
+              kODAttributeTypeHomeDirectory,
+              kODAttributeTypeEMailAddress ];
+}
+
++ (NSArray*)groupAttributes
+{
+    return @[ kODAttributeTypeRecordName,
+              kODAttributeTypeGUID,
+              kODAttributeTypePrimaryGroupID,
+              kODAttributeTypeGroupMembership ];
+}
+
+- (ODReconcilePlan*)planForRecordList:(ODRecordList*)desired error:(NSError* __autoreleasing*)error
+{
+    NSDictionary* currentUsers = [ODManagerRecord recordsOfType:kODRecordTypeUsers
+                                                     attributes:[[self class] userAttributes]
+                                                           node:_node
+                                                          error:error];
+    if (!currentUsers) {
+        return nil;
+    }
+
+    NSDictionary* currentGroups = [ODManagerRecord recordsOfType:kODRecordTypeGroups
+                                                      attributes:[[self class] groupAttributes]
+                                                            node:_node
+                                                           error:error];
+    if (!currentGroups) {
+        return nil;
+    }
+
+    ODReconcilePlan* plan = [ODReconcilePlan new];
+    NSMutableArray* usersToCreate = [NSMutableArray new];
+    NSMutableArray* rejectedUsers = [NSMutableArray new];
+    NSMutableDictionary* userUpdates = [NSMutableDictionary new];
+    NSMutableSet* desiredUserNames = [NSMutableSet setWithCapacity:desired.users.count];
+    NSMutableDictionary* userGUIDs = [NSMutableDictionary dictionaryWithCapacity:currentUsers.count];
+
+    [currentUsers enumerateKeysAndObjectsUsingBlock:^(NSString* name, ODRecord* record, BOOL* stop) {
+        NSString* guid = [[record valuesForAttribute:kODAttributeTypeGUID error:nil] lastObject];
+        if (guid) {
+            userGUIDs[name] = guid;
+        }
+    }];
+
+    for (ODUser* user in desired.users) {
+        if (!user.userName) {
+            [rejectedUsers addObject:user];
+            continue;
+        }
+        /* listed, so never deleted as unlisted even when it can't be planned */
+        [desiredUserNames addObject:user.userName];
+        if (!user.firstName || !user.lastName) {
+            [rejectedUsers addObject:user];
+            continue;
+        }
+
+        ODRecord* record = currentUsers[user.userName];
+        if (!record) {
+            [usersToCreate addObject:user];
+            continue;
+        }
+
+        NSDictionary* changes = [self changesForUser:user record:record];
+        if (changes.count) {
+            userUpdates[user.userName] = changes;
+        }
+    }
+
+    NSMutableArray* usersToDelete = [NSMutableArray new];
+    if (_deleteUnlistedUsers) {
+        [currentUsers enumerateKeysAndObjectsUsingBlock:^(NSString* name, ODRecord* record, BOOL* stop) {
+            if (![desiredUserNames containsObject:name] && [self canDeleteRecord:record name:name idAttribute:kODAttributeTypeUniqueID]) {
+                [usersToDelete addObject:name];
+            }
+        }];
+    }
+
+    /* users that will exist once the plan runs */
+    NSMutableSet* finalUserNames = [NSMutableSet setWithArray:currentUsers.allKeys];
+    [finalUserNames minusSet:[NSSet setWithArray:usersToDelete]];
+    [finalUserNames unionSet:desiredUserNames];
+
+    NSMutableArray* groupsToCreate = [NSMutableArray new];
+    NSMutableSet* desiredGroupNames = [NSMutableSet setWithCapacity:desired.groups.count];
+    NSMutableDictionary* desiredMembership = [NSMutableDictionary new];
+    NSMutableDictionary* membersToAdd = [NSMutableDictionary new];
+    NSMutableDictionary* membersToRemove = [NSMutableDictionary new];
+    NSMutableSet* usedGIDs = [NSMutableSet setWithCapacity:currentGroups.count];
+
+    [currentGroups enumerateKeysAndObjectsUsingBlock:^(NSString* name, ODRecord* record, BOOL* stop) {
+        NSString* gid = record.primaryGroup;
+        if (gid) {
+            [usedGIDs addObject:gid];
+        }
+    }];
+
+    for (ODGroup* group in desired.groups) {
+        if (!group.groupName) {
+            continue;
+        }
+        [desiredGroupNames addObject:group.groupName];
+
+        ODRecord* record = currentGroups[group.groupName];
+        if (!record) {
+            [groupsToCreate addObject:group];
+            continue;
+        }
+
+        if (!group.members) {
+            continue;
+        }
+
+        NSSet* current = [NSSet setWithArray:[record valuesForAttribute:kODAttributeTypeGroupMembership error:nil] ?: @[]];
+        NSMutableSet* wanted = [NSMutableSet setWithArray:group.members];
+        [wanted intersectSet:finalUserNames];
+
+        NSMutableSet* add = [wanted mutableCopy];
+        [add minusSet:current];
+        NSMutableSet* remove = [current mutableCopy];
+        [remove minusSet:wanted];
+
+        if (add.count || remove.count) {
+            desiredMembership[group.groupName] = [wanted allObjects];
+            if (add.count) {
+                membersToAdd[group.groupName] = [add allObjects];
+            }
+            if (remove.count) {
+                membersToRemove[group.groupName] = [remove allObjects];
+            }
+        }
+    }
+
+    NSMutableArray* groupsToDelete = [NSMutableArray new];
+    if (_deleteUnlistedGroups) {
+        [currentGroups enumerateKeysAndObjectsUsingBlock:^(NSString* name, ODRecord* record, BOOL* stop) {
+            if (![desiredGroupNames containsObject:name] && [self canDeleteRecord:record name:name idAttribute:kODAttributeTypePrimaryGroupID]) {
+                [groupsToDelete addObject:name];
+            }
+        }];
+    }
+
+    plan.usersToCreate = usersToCreate;
+    plan.userUpdates = userUpdates;
+    plan.usersToDelete = usersToDelete;
+    plan.rejectedUsers = rejectedUsers;
+    plan.groupsToCreate = groupsToCreate;
+    plan.groupsToDelete = groupsToDelete;
+    plan.membersToAdd = membersToAdd;
+    plan.membersToRemove = membersToRemove;
+    plan.desiredMembership = desiredMembership;
+    plan.userGUIDs = userGUIDs;
+    plan.usedGIDs = usedGIDs;
+    return plan;
+}
+
+- (NSDictionary*)changesForUser:(ODUser*)user record:(ODRecord*)record
+{
+    /* openDirectoryAttributes would fill in and compare library defaults, resetting values the list left empty */
+    NSDictionary* attributes = user.suppliedAttributes;
+    NSMutableDictionary* changes = [NSMutableDictionary new];
+
+    [attributes enumerateKeysAndObjectsUsingBlock:^(NSString* attribute, NSArray* values, BOOL* stop) {
+        NSArray* current = [record valuesForAttribute:attribute error:nil];
+        if (![current isEqualToArray:values]) {
+            changes[attribute] = values;
+        }
+    }];
+    return changes;
+}
+
+- (BOOL)canDeleteRecord:(ODRecord*)record name:(NSString*)name idAttribute:(NSString*)idAttribute
+{
+    if ([_protectedRecordNames containsObject:name]) {
+        return NO;
+    }
+    NSString* recordID = [[record valuesForAttribute:idAttribute error:nil] lastObject];
+    return recordID && recordID.integerValue >= kODMFirstDirectoryID;
+}
+
+#pragma mark - Apply
+- (BOOL)applyPlan:(ODReconcilePlan*)plan job:(ODManagerJob*)job error:(NSError* __autoreleasing*)error
+{
+    if (!_node) {
+        return [ODManagerError errorWithCode:kODMerrNoDirectoryNode error:error];
+    }
+
+    if (!job) {
+        job = [ODManagerJob new];
+    }
+    [job beginWithTotal:plan.changeCount + plan.rejectedUsers.count];
+
+    NSOperationQueue* queue = [NSOperationQueue new];
+    queue.maxConcurrentOperationCount = _maxConcurrentOperations ? _maxConcurrentOperations : kODMDefaultReconcileConcurrency;
+    NSUInteger batchSize = _batchSize ? _batchSize : kODMDefaultReconcileBatchSize;
+
+    __block NSError* lastError;
+    NSMutableDictionary* userGUIDs = [plan.userGUIDs mutableCopy];
+    ODNode* node = _node;
+
+    void (^fail)(NSString*, NSError*) = ^(NSString* name, NSError* err) {
+        @synchronized(job)
+        {
+            lastError = err;
+        }
+        [ODManagerError logError:err];
+        [job recordFailure:name error:err];
+    };
+
+    void (^resolveMembers)(NSArray*, NSMutableArray*, NSMutableArray*) = ^(NSArray* members, NSMutableArray* names, NSMutableArray* guids) {
+        @synchronized(userGUIDs)
+        {
+            for (NSString* member in members) {
+                NSString* guid = userGUIDs[member];
+                if (guid) {
+                    [names addObject:member];
+                    [guids addObject:guid];
+                }
+            }
+        }
+    };
+
+    for (ODUser* user in plan.rejectedUsers) {
+        NSError* err;
+        [ODManagerError errorWithCode:kODMerrIncompleteUserObject error:&err];
+        fail(user.userName, err);
+    }
+
+    /* groups first so new users can be placed in them */
+    ODGIDAllocator* allocator = _gidAllocator ? _gidAllocator : [ODGIDAllocator new];
+    NSError* allocatorError;
+    if (plan.groupsToCreate.count) {
+        /* other tools may have added groups since the shared allocator was read */
+        [allocator setNeedsLoad];
+        if (![allocator loadIfNeededFromNode:node error:&allocatorError] && !allocatorError) {
+            [ODManagerError errorWithCode:kODMerrCouldNotAddGroup error:&allocatorError];
+        }
+    }
+    /* the plan read every group, so IDs outside the allocator's range are claimed from it too */
+    for (NSString* used in plan.usedGIDs) {
+        [allocator claimID:[ODGIDAllocator IDFromString:used]];
+    }
+    NSMutableArray* newGroups = [NSMutableArray arrayWithCapacity:plan.groupsToCreate.count];
+    for (ODGroup* group in plan.groupsToCreate) {
+        NSError* err;
+        NSUInteger gid;
+        if (allocatorError) {
+            err = allocatorError;
+            gid = NSNotFound;
+        } else if (group.gid) {
+            gid = [ODGIDAllocator IDFromString:group.gid];
+            if (gid == NSNotFound) {
+                [ODManagerError errorWithMessage:[NSString stringWithFormat:@"%@ is not a valid group ID", group.gid] error:&err];
+            } else if (![allocator claimID:gid]) {
+                [ODManagerError errorWithMessage:[NSString stringWithFormat:@"group ID %lu is already used", (unsigned long)gid] error:&err];
+                gid = NSNotFound;
+            }
+        } else {
+            gid = [allocator allocateID];
+            if (gid == NSNotFound) {
+                [ODManagerError errorWithCode:kODMerrCouldNotAddGroup error:&err];
+            }
+        }
+        if (gid == NSNotFound) {
+            fail(group.groupName, err);
+            continue;
+        }
+        [newGroups addObject:@[ group, [@(gid) stringValue] ]];
+    }
+
+    [job addBatchesOfItems:plan.usersToCreate
+                      size:batchSize
+                   toQueue:queue
+                     block:^(ODUser* user) {
+        NSError* err;
+        ODRecord* record = [node createRecordWithRecordType:kODRecordTypeUsers
+                                                       name:user.userName
+                                                 attributes:user.openDirectoryAttributes
+                                                      error:&err];
+        if (record && user.passWord && ![record changePassword:nil toPassword:user.passWord error:&err]) {
+            record = nil;
+        }
+        if (!record) {
+            fail(user.userName, err);
+            return;
+        }
+        NSString* guid = [[record valuesForAttribute:kODAttributeTypeGUID error:nil] lastObject];
+        @synchronized(userGUIDs)
+        {
+            if (guid) {
+                userGUIDs[user.userName] = guid;
+            }
+        }
+        [job recordSuccess:user.userName];
+    }];
+
+    [job addBatchesOfItems:plan.userUpdates.allKeys
+                      size:batchSize
+                   toQueue:queue
+                     block:^(NSString* name) {
+        NSError* err;
+        ODRecord* record = [ODManagerRecord getUserRecord:name node:node error:&err];
+        NSDictionary* changes = plan.userUpdates[name];
+        for (NSString* attribute in changes) {
+            if (![record setValue:changes[attribute] forAttribute:attribute error:&err]) {
+                fail(name, err);
+                return;
+            }
+        }
+        [job recordSuccess:name];
+    }];
+    [queue waitUntilAllOperationsAreFinished];
+
+    /* new groups are created with their members already in place */
+    [job addBatchesOfItems:newGroups
+                      size:batchSize
+                   toQueue:queue
+                     block:^(NSArray* entry) {
+        ODGroup* group = entry[0];
+        NSMutableDictionary* attributes = [NSMutableDictionary dictionaryWithObject:@[ entry[1] ] forKey:kODAttributeTypePrimaryGroupID];
+        if (group.fullName) {
+            attributes[kODAttributeTypeFullName] = @[ group.fullName ];
+        }
+        if (group.members.count) {
+            NSMutableArray* names = [NSMutableArray arrayWithCapacity:group.members.count];
+            NSMutableArray* guids = [NSMutableArray arrayWithCapacity:group.members.count];
+            resolveMembers(group.members, names, guids);
+            attributes[kODAttributeTypeGroupMembership] = names;
+            attributes[kODAttributeTypeGroupMembers] = guids;
+        }
+        NSError* err;
+        if ([node createRecordWithRecordType:kODRecordTypeGroups name:group.groupName attributes:attributes error:&err]) {
+            [job recordSuccess:group.groupName];
+        } else {
+            [allocator releaseID:[entry[1] integerValue]];
+            fail(group.groupName, err);
+        }
+    }];
+
+    /* one write per changed group instead of one per member */
+    [job addBatchesOfItems:plan.desiredMembership.allKeys
+                      size:batchSize
+                   toQueue:queue
+                     block:^(NSString* name) {
+        NSArray* members = plan.desiredMembership[name];
+        NSMutableArray* names = [NSMutableArray arrayWithCapacity:members.count];
+        NSMutableArray* guids = [NSMutableArray arrayWithCapacity:members.count];
+        resolveMembers(members, names, guids);
+
+        NSError* err;
+        ODRecord* record = [ODManagerRecord getGroupRecord:name node:node error:&err];
+        if (record
+            && [record setValue:names forAttribute:kODAttributeTypeGroupMembership error:&err]
+            && [record setValue:guids forAttribute:kODAttributeTypeGroupMembers error:&err]) {
+            [job recordSuccess:name];
+        } else {
+            fail(name, err);
+        }
+    }];
+    [queue waitUntilAllOperationsAreFinished];
+
+    /* each entry carries its record type, a user and a group can share a name */
+    NSMutableArray* deletions = [NSMutableArray arrayWithCapacity:plan.usersToDelete.count + plan.groupsToDelete.count];
+    for (NSString* name in plan.usersToDelete) {
+        [deletions addObject:@[ name, kODRecordTypeUsers ]];
+    }
+    for (NSString* name in plan.groupsToDelete) {
+        [deletions addObject:@[ name, kODRecordTypeGroups ]];
+    }
+    NSMutableDictionary* deletedUsers = [NSMutableDictionary dictionaryWithCapacity:plan.usersToDelete.count];
+    [job addBatchesOfItems:deletions
+                      size:batchSize
+                   toQueue:queue
+                     block:^(NSArray* entry) {
+        NSError* err;
+        NSString* name = entry[0];
+        BOOL isUser = [entry[1] isEqualToString:kODRecordTypeUsers];
+        ODRecord* record = isUser ? [ODManagerRecord getUserRecord:name node:node error:&err]
+                                  : [ODManagerRecord getGroupRecord:name node:node error:&err];
+        if ([record deleteRecordAndReturnError:&err]) {
+            if (isUser) {
+                @synchronized(deletedUsers)
+                {
+                    deletedUsers[name] = plan.userGUIDs[name] ?: @"";
+                }
+            }
+            [job recordSuccess:name];
+        } else {
+            fail(name, err);
+        }
+    }];
+    [queue waitUntilAllOperationsAreFinished];
+
+    /* groups the plan didn't rewrite still list the deleted users, read them again now that the deletes are done */
+    if (deletedUsers.count) {
+        NSError* err;
+        NSDictionary* groups = [ODManagerRecord recordsOfType:kODRecordTypeGroups
+                                                   attributes:@[ kODAttributeTypeRecordName, kODAttributeTypeGroupMembership, kODAttributeTypeGroupMembers ]
+                                                         node:node
+                                                        error:&err];
+        if (!groups || ![ODManagerEditor removeMembers:deletedUsers fromGroupRecords:groups.allValues queue:queue error:&err]) {
+            [ODManagerError logError:err];
+            lastError = err;
+        }
+    }
+
+    if (job.isCancelled) {
+        [ODManagerError errorWithMessage:@"Reconcile Canceled" error:&lastError];
+    }
+
+    if (error) {
+        *error = lastError;
+    }
+    [job finishWithError:lastError];
+    return lastError == nil;
+}
+
+@end
@@ -25,6 +25,7 @@
 
 #import "ODManager.h"
 #import <OpenDirectory/OpenDirectory.h>
+#import "ODStringPool.h"
 
 
 @interface ODManagerRecord : ODRecord <ODQueryDelegate>
@@ -38,6 +39,41 @@
 -(id)initWithNode:(ODNode *)node delegate:(id<ODManagerDelegate>)delegate;
 
 -(void)asyncQueryWithType:(NSString*)type;
+
+/**
+ *  number of undelivered batches that may queue up before the query is paused. Defaults to 4
+ */
+@property NSUInteger maxPendingBatches;
+
+/**
+ *  Asynchronous query that delivers materialized records in batches
+ *
+ *  @param type       record type to query
+ *  @param batchSize  number of records per batch, 0 for the default of 100
+ *  @param queue      queue the blocks are called on, nil for the main queue
+ *  @param batch      called with an array of ODUser, ODGroup or ODPreset objects
+ *  @param completion called once after the last batch has been handled, with an error if the query failed
+ *  @discussion the query runs on its own thread and stops reading from the server while the consumer is maxPendingBatches behind.  Batches are handled one at a time in the order they were read, on a concurrent queue too
+ */
+-(void)asyncQueryWithType:(NSString*)type
+                batchSize:(NSUInteger)batchSize
+                    queue:(NSOperationQueue*)queue
+                    batch:(void(^)(NSArray *records))batch
+               completion:(void(^)(NSError *error))completion;
+
+/**
+ *  Stop a batched query
+ *  @discussion batches already queued are still handled, then completion is called with a cancel error.  Does nothing if the query has already finished.
+ */
+-(void)cancelQuery;
+
+/**
+ *  pool that repeated attribute values are interned through while records are materialized, nil to skip interning
+ */
+@property (strong) ODStringPool *stringPool;
+
++(id)objectForRecord:(ODRecord*)record;
++(id)objectForRecord:(ODRecord*)record pool:(ODStringPool*)pool;
 -(NSArray *)listQueryWithType:(NSString *)type;
 
 +(ODRecord *)getUserRecord:(NSString *)user node:(ODNode*)node error:(NSError **)error;
@@ -45,6 +81,40 @@
 +(ODRecord *)getPresetRecord:(NSString *)preset node:(ODNode*)node error:(NSError **)error;
 +(ODRecord *)getRecordByGUID:(NSString *)guid type:(NSString*)type node:(ODNode *)node error:(NSError *__autoreleasing *)error;
 
+/**
+ *  Every record of a type in one query
+ *
+ *  @param type       record type
+ *  @param attributes attributes to return with each record, nil for the standard set
+ *  @param node       node to query
+ *  @param error      populated should error occur
+ *
+ *  @return dictionary of record name -> ODRecord
+ */
++(NSDictionary*)recordsOfType:(NSString*)type attributes:(NSArray*)attributes node:(ODNode*)node error:(NSError **)error;
+
+/**
+ *  Look up a list of records by name in a few queries
+ *
+ *  @return dictionary of record name -> ODRecord, names that don't exist are left out
+ */
++(NSDictionary*)recordsOfType:(NSString*)type names:(NSArray*)names attributes:(NSArray*)attributes node:(ODNode*)node error:(NSError **)error;
+
+/**
+ *  Record names whose attributes match a value, for typeahead searches against the server
+ *
+ *  @param type       record type
+ *  @param value      text to match
+ *  @param matchType  kODMatchBeginsWith or kODMatchContains
+ *  @param attributes attributes to match against, one query each until limit is reached
+ *  @param limit      maximum number of names, passed to the server as the query's result limit
+ *  @param node       node to query
+ *  @param error      populated should error occur
+ *
+ *  @return unique record names
+ */
++(NSArray*)recordNamesOfType:(NSString*)type matching:(NSString*)value matchType:(ODMatchType)matchType attributes:(NSArray*)attributes limit:(NSUInteger)limit node:(ODNode*)node error:(NSError **)error;
+
 +(NSArray*)groupMembers:(NSString*)group node:(ODNode*)node;
 +(ODPreset *)settingsForPrest:(NSString*)preset node:(ODNode*)node;
 +(BOOL)user:(NSString*)user isMemberOfGroup:(NSString*)group node:(ODNode*)node error:(NSError **)error;
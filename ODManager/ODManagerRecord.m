@@ -27,11 +27,27 @@
 #import "ODManagerError.h"
 #import "TBXML.h"
 
+static NSUInteger const kODMDefaultQueryBatchSize = 100;
+static NSUInteger const kODMDefaultMaxPendingBatches = 4;
+
 @implementation ODManagerRecord{
     ODQuery *_query;
     NSDictionary *_queryReturn;
     NSMutableArray *_replyResults;
     BOOL queryFault;
+
+    /* batched query state */
+    NSThread *_queryThread;
+    NSOperationQueue *_batchQueue;
+    NSOperation *_lastBatchOperation;
+    NSMutableArray *_pendingBatch;
+    NSUInteger _batchSize;
+    dispatch_semaphore_t _bufferSlots;
+    NSUInteger _bufferSize;
+    void (^_batchHandler)(NSArray *records);
+    void (^_batchCompletion)(NSError *error);
+    volatile BOOL _queryFinished;
+    BOOL _completionScheduled;
 }
 -(id)initWithNode:(ODNode *)node{
     self = [super init];
@@ -93,6 +109,11 @@
 }
 
 -(void)query:(ODQuery *)inQuery foundResults:(NSArray *)inResults error:(NSError *)inError{
+    if(_batchHandler){
+        [self batchQuery:inQuery foundResults:inResults error:inError];
+        return;
+    }
+
     if(inError){
         NSLog(@"Error during query: %@", inError.localizedDescription );
         queryFault = YES;
@@ -103,22 +124,7 @@
     }
     
     for (ODRecord *record in inResults) {
-        id returnRecord;
-
-        if([[record recordType] isEqualToString:kODRecordTypeUsers]){
-            returnRecord = [ODUser new];
-            [(ODUser*) returnRecord setUserName:record.recordName];
-            [(ODUser*) returnRecord setFirstName:record.firstName];
-            [(ODUser*) returnRecord setLastName:record.lastName];
-            [(ODUser*) returnRecord setUid:record.uid];
-            [(ODUser*) returnRecord setUserShell:record.userShell];
-        }else if ([[record recordType] isEqualToString:kODRecordTypePresetUsers]){
-            returnRecord = [ODPreset new];
-            [(ODPreset*) returnRecord setPresetName:record.recordName];
-        }else if ([[record recordType] isEqualToString:kODRecordTypeGroups]){
-            returnRecord = [ODGroup new];
-            [(ODGroup*) returnRecord setGroupName:record.recordName];
-        }
+        id returnRecord = [[self class] objectForRecord:record pool:_stringPool];
         
         if(_delegate)
             [_delegate didRecieveQueryUpdate:returnRecord];
@@ -127,7 +133,184 @@
     }
 }
 
++(id)objectForRecord:(ODRecord*)record{
+    return [self objectForRecord:record pool:nil];
+}
+
++(id)objectForRecord:(ODRecord*)record pool:(ODStringPool*)pool{
+    id returnRecord;
+    NSString *recordType = [record recordType];
+    
+    if([recordType isEqualToString:kODRecordTypeUsers]){
+        returnRecord = [ODUser new];
+        [(ODUser*) returnRecord setUserName:record.recordName];
+        [(ODUser*) returnRecord setFirstName:record.firstName];
+        [(ODUser*) returnRecord setLastName:record.lastName];
+        [(ODUser*) returnRecord setUid:record.uid];
+
+        /* these come from the preset the user was created with, so a handful of values repeat across
+           every record; with a pool every record shares one instance of each.  The home paths are kept
+           as the prefix the user name was appended to, the same way ODUser builds them */
+        NSString *nfsPath = [record.NFSHomeDirectory stringByDeletingLastPathComponent];
+        NSString *sharePoint = record.sharePoint;
+        NSString *sharePath = [record.sharePath stringByDeletingLastPathComponent];
+        if(!sharePath.length)sharePath = nil;
+        [(ODUser*) returnRecord setNfsPath:pool ? [pool intern:nfsPath] : nfsPath];
+        [(ODUser*) returnRecord setSharePoint:pool ? [pool intern:sharePoint] : sharePoint];
+        [(ODUser*) returnRecord setSharePath:pool ? [pool intern:sharePath] : sharePath];
+        [(ODUser*) returnRecord setUserShell:pool ? [pool intern:record.userShell] : record.userShell];
+        [(ODUser*) returnRecord setPrimaryGroup:pool ? [pool intern:record.primaryGroup] : record.primaryGroup];
+    }else if ([recordType isEqualToString:kODRecordTypePresetUsers]){
+        returnRecord = [ODPreset new];
+        [(ODPreset*) returnRecord setPresetName:record.recordName];
+    }else if ([recordType isEqualToString:kODRecordTypeGroups]){
+        returnRecord = [ODGroup new];
+        [(ODGroup*) returnRecord setGroupName:record.recordName];
+    }
+    return returnRecord;
+}
+
+#pragma mark - Batched Query
+-(void)asyncQueryWithType:(NSString *)type
+                batchSize:(NSUInteger)batchSize
+                    queue:(NSOperationQueue *)queue
+                    batch:(void (^)(NSArray *))batch
+               completion:(void (^)(NSError *))completion
+{
+    NSError *err;
+    _batchSize = batchSize ? batchSize : kODMDefaultQueryBatchSize;
+    _bufferSize = _maxPendingBatches ? _maxPendingBatches : kODMDefaultMaxPendingBatches;
+    _batchQueue = queue ? queue : [NSOperationQueue mainQueue];
+    _batchHandler = [batch copy];
+    _batchCompletion = [completion copy];
+    _bufferSlots = dispatch_semaphore_create(_bufferSize);
+    _pendingBatch = [[NSMutableArray alloc]initWithCapacity:_batchSize];
+    _lastBatchOperation = nil;
+    _queryFinished = NO;
+    _completionScheduled = NO;
+    
+    _query = [ODQuery queryWithNode: _node
+                     forRecordTypes: type
+                          attribute: kODAttributeTypeRecordName
+                          matchType: kODMatchAny
+                        queryValues: nil
+                   returnAttributes: kODAttributeTypeStandardOnly
+                     maximumResults: 0
+                              error: &err];
+    
+    if(!_query){
+        if(!err)[ODManagerError errorWithCode:kODMerrNoDirectoryNode error:&err];
+        [self finishBatchQueryWithError:err];
+        return;
+    }
+    
+    [_query setDelegate:self];
+    
+    /* the query gets its own run loop so blocking it for backpressure never stalls the caller */
+    _queryThread = [[NSThread alloc]initWithTarget:self selector:@selector(runBatchQuery) object:nil];
+    _queryThread.name = @"com.eeaapps.odmanager.query";
+    [_queryThread start];
+}
+
+-(void)runBatchQuery{
+    @autoreleasepool {
+        NSRunLoop *runLoop = [NSRunLoop currentRunLoop];
+        [_query scheduleInRunLoop:runLoop forMode:NSDefaultRunLoopMode];
+        while(!_queryFinished){
+            @autoreleasepool {
+                [runLoop runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.5]];
+            }
+        }
+        [_query removeFromRunLoop:runLoop forMode:NSDefaultRunLoopMode];
+    }
+}
+
+/* stops the query thread and any wait for a buffer slot, then completes with a cancel error
+   unless the query had already finished on its own */
+-(void)cancelQuery{
+    _queryFinished = YES;
+    NSError *err;
+    [ODManagerError errorWithMessage:@"Query Canceled" error:&err];
+    [self finishBatchQueryWithError:err];
+}
 
+-(void)batchQuery:(ODQuery *)inQuery foundResults:(NSArray *)inResults error:(NSError *)inError{
+    if(_queryFinished){
+        return;
+    }
+    
+    for (ODRecord *record in inResults) {
+        id returnRecord = [[self class] objectForRecord:record pool:_stringPool];
+        if(returnRecord)[_pendingBatch addObject:returnRecord];
+        if(_pendingBatch.count >= _batchSize){
+            if(![self deliverPendingBatch])return;
+        }
+    }
+    
+    if(inError || !inResults){
+        [self deliverPendingBatch];
+        _queryFinished = YES;
+        [self finishBatchQueryWithError:inError];
+    }
+}
+
+/* Hands the current batch to the consumer queue.  When every buffer slot is in use
+   this blocks the query thread, which stops the ODQuery from delivering more results
+   until the consumer catches up. */
+-(BOOL)deliverPendingBatch{
+    if(!_pendingBatch.count){
+        return YES;
+    }
+    
+    while(dispatch_semaphore_wait(_bufferSlots, dispatch_time(DISPATCH_TIME_NOW, 100 * NSEC_PER_MSEC))){
+        if(_queryFinished)return NO;
+    }
+    
+    NSArray *batch = [_pendingBatch copy];
+    [_pendingBatch removeAllObjects];
+    
+    void (^handler)(NSArray*) = _batchHandler;
+    dispatch_semaphore_t slots = _bufferSlots;
+    NSBlockOperation *operation = [NSBlockOperation blockOperationWithBlock:^{
+        handler(batch);
+        dispatch_semaphore_signal(slots);
+    }];
+    /* batches are handled one at a time and in order even when the queue is concurrent */
+    if(_lastBatchOperation)[operation addDependency:_lastBatchOperation];
+    _lastBatchOperation = operation;
+    [_batchQueue addOperation:operation];
+    return YES;
+}
+
+-(void)finishBatchQueryWithError:(NSError*)error{
+    @synchronized(self){
+        if(_completionScheduled || !_batchHandler)return;
+        _completionScheduled = YES;
+    }
+    void (^completion)(NSError*) = _batchCompletion;
+    dispatch_semaphore_t slots = _bufferSlots;
+    NSUInteger bufferSize = _bufferSize;
+    NSOperationQueue *queue = _batchQueue;
+    
+    if(error){
+        NSLog(@"Error during query: %@", error.localizedDescription );
+    }
+    
+    /* completion goes out only after every delivered batch has been consumed */
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        for(NSUInteger i = 0; i < bufferSize; i++){
+            dispatch_semaphore_wait(slots, DISPATCH_TIME_FOREVER);
+        }
+        if(completion){
+            [queue addOperationWithBlock:^{
+                completion(error);
+            }];
+        }
+        for(NSUInteger i = 0; i < bufferSize; i++){
+            dispatch_semaphore_signal(slots);
+        }
+    });
+}
 
 #pragma mark - Class Methods
 +(ODRecord *)getUserRecord:(NSString *)user node:(ODNode *)node error:(NSError *__autoreleasing *)error
@@ -189,6 +372,105 @@
 }
 
 
++(NSDictionary*)recordsOfType:(NSString*)type attributes:(NSArray*)attributes node:(ODNode*)node error:(NSError *__autoreleasing *)error{
+    if(!node){
+        [ODManagerError errorWithCode:kODMerrNoDirectoryNode error:error];
+        return nil;
+    }
+    
+    NSError *err;
+    ODQuery *query = [ODQuery queryWithNode: node
+                             forRecordTypes: type
+                                  attribute: kODAttributeTypeRecordName
+                                  matchType: kODMatchAny
+                                queryValues: nil
+                           returnAttributes: attributes ? attributes : kODAttributeTypeStandardOnly
+                             maximumResults: 0
+                                      error: &err];
+    
+    NSArray *results = [query resultsAllowingPartial:NO error:&err];
+    if(!results){
+        if(error)*error = err;
+        return nil;
+    }
+    
+    NSMutableDictionary *records = [[NSMutableDictionary alloc]initWithCapacity:results.count];
+    for(ODRecord *record in results){
+        NSString *name = record.recordName;
+        if(name)records[name] = record;
+    }
+    return records;
+}
+
++(NSDictionary*)recordsOfType:(NSString*)type names:(NSArray*)names attributes:(NSArray*)attributes node:(ODNode*)node error:(NSError *__autoreleasing *)error{
+    if(!node){
+        [ODManagerError errorWithCode:kODMerrNoDirectoryNode error:error];
+        return nil;
+    }
+    
+    /* one query per chunk of names rather than one per record */
+    static NSUInteger const chunkSize = 200;
+    NSMutableDictionary *records = [[NSMutableDictionary alloc]initWithCapacity:names.count];
+    for(NSUInteger i = 0; i < names.count; i += chunkSize){
+        NSArray *chunk = [names subarrayWithRange:NSMakeRange(i, MIN(chunkSize, names.count - i))];
+        NSError *err;
+        ODQuery *query = [ODQuery queryWithNode: node
+                                 forRecordTypes: type
+                                      attribute: kODAttributeTypeRecordName
+                                      matchType: kODMatchEqualTo
+                                    queryValues: chunk
+                               returnAttributes: attributes ? attributes : kODAttributeTypeStandardOnly
+                                 maximumResults: 0
+                                          error: &err];
+        NSArray *results = [query resultsAllowingPartial:NO error:&err];
+        if(!results){
+            if(error)*error = err;
+            return nil;
+        }
+        for(ODRecord *record in results){
+            NSString *name = record.recordName;
+            if(name)records[name] = record;
+        }
+    }
+    return records;
+}
+
++(NSArray*)recordNamesOfType:(NSString*)type matching:(NSString*)value matchType:(ODMatchType)matchType attributes:(NSArray*)attributes limit:(NSUInteger)limit node:(ODNode*)node error:(NSError *__autoreleasing *)error{
+    if(!node){
+        [ODManagerError errorWithCode:kODMerrNoDirectoryNode error:error];
+        return nil;
+    }
+    
+    NSMutableOrderedSet *names = [NSMutableOrderedSet new];
+    for(NSString *attribute in attributes){
+        if(limit && names.count >= limit)break;
+        
+        NSError *err;
+        ODQuery *query = [ODQuery queryWithNode: node
+                                 forRecordTypes: type
+                                      attribute: attribute
+                                      matchType: matchType
+                                    queryValues: value
+                               returnAttributes: kODAttributeTypeRecordName
+                                 maximumResults: limit ? limit - names.count : 0
+                                          error: &err];
+        NSArray *results = [query resultsAllowingPartial:NO error:&err];
+        if(!results){
+            if(error)*error = err;
+            return nil;
+        }
+        for(ODRecord *record in results){
+            NSString *name = record.recordName;
+            if(name)[names addObject:name];
+        }
+    }
+    
+    if(limit && names.count > limit){
+        return [names.array subarrayWithRange:NSMakeRange(0, limit)];
+    }
+    return names.array;
+}
+
 +(NSArray*)groupMembers:(NSString*)group node:(ODNode*)node{
     ODRecord  *record = [self getGroupRecord:group node:node error:nil];
     NSDictionary *attributes= [record recordDetailsForAttributes:@[kODAttributeTypeGroupMembership] error:nil];
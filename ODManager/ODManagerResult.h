@@ -0,0 +1,106 @@
+//
+//  ODManagerResult.h
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ *  Per record outcomes of a bulk job.
+ *  @discussion each record costs one name and one 32 bit slot in a dense status array.  Only failures keep more, their own NSError, and messages are only localized when asked for.
+ */
+@interface ODManagerResult : NSObject
+
+/**
+ *  number of records with an outcome
+ */
+@property (readonly) NSUInteger count;
+@property (readonly) NSUInteger successCount;
+@property (readonly) NSUInteger failureCount;
+
+/**
+ *  record name at an index, in the order outcomes were recorded
+ */
+- (NSString*)nameAtIndex:(NSUInteger)index;
+
+/**
+ *  error code for the record at an index, 0 for success
+ */
+- (NSInteger)statusAtIndex:(NSUInteger)index;
+
+/**
+ *  error the record at an index failed with, nil for success
+ */
+- (NSError*)errorAtIndex:(NSUInteger)index;
+
+/**
+ *  record names that succeeded, in order
+ */
+- (NSArray*)succeededNames;
+
+/**
+ *  record names that failed, in order
+ */
+- (NSArray*)failedNames;
+
+/**
+ *  NSNumber error code -> array of record names that failed with it
+ */
+- (NSDictionary*)failuresByCode;
+
+/**
+ *  localized message of the first failure with an error code, nil if none failed with it
+ */
+- (NSString*)messageForCode:(NSInteger)code;
+
+/**
+ *  one line count of successes and failures per error code, suitable for logging
+ */
+- (NSString*)summary;
+
+/**
+ *  Write one JSON object per record: name, status and, for failures, domain and message
+ *
+ *  @param stream open output stream
+ *  @param error  populated should error occur
+ *
+ *  @return YES for success, NO on failure.
+ */
+- (BOOL)writeJSONLinesToStream:(NSOutputStream*)stream error:(NSError**)error;
+
+/**
+ *  Write the result to a JSONL file, replacing it if it exists
+ *
+ *  @param path  file path
+ *  @param error populated should error occur
+ *
+ *  @return YES for success, NO on failure.
+ */
+- (BOOL)writeJSONLinesToPath:(NSString*)path error:(NSError**)error;
+
+/**
+ *  Record an outcome, a nil error means success
+ */
+- (void)addName:(NSString*)name error:(NSError*)error;
+
+@end
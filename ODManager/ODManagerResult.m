@@ -0,0 +1,270 @@
+//
+//  ODManagerResult.m
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "ODManagerResult.h"
+#import "ODManagerError.h"
+
+/* slot 0 of the outcome table is success, every failure gets a slot of its own for its error */
+static uint32_t const kODMResultSuccess = 0;
+
+@implementation ODManagerResult {
+    NSMutableArray* _names;
+    NSMutableData* _status; // uint32_t outcome slot per record
+    NSMutableArray* _outcomes; // slot -> NSError, NSNull for success
+    NSUInteger _failureCount;
+}
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        _names = [NSMutableArray new];
+        _status = [NSMutableData new];
+        _outcomes = [NSMutableArray arrayWithObject:[NSNull null]];
+    }
+    return self;
+}
+
+#pragma mark - Record
+- (void)addName:(NSString*)name error:(NSError*)error
+{
+    @synchronized(self)
+    {
+        uint32_t slot = kODMResultSuccess;
+        if (error) {
+            /* errors that share a domain and code still differ in message and userInfo, each failure keeps its own */
+            slot = (uint32_t)_outcomes.count;
+            [_outcomes addObject:error];
+            _failureCount++;
+        }
+        [_names addObject:name ? name : @""];
+        [_status appendBytes:&slot length:sizeof(slot)];
+    }
+}
+
+#pragma mark - Access
+- (NSUInteger)count
+{
+    @synchronized(self)
+    {
+        return _names.count;
+    }
+}
+
+- (NSUInteger)successCount
+{
+    @synchronized(self)
+    {
+        return _names.count - _failureCount;
+    }
+}
+
+- (NSUInteger)failureCount
+{
+    @synchronized(self)
+    {
+        return _failureCount;
+    }
+}
+
+/* caller holds the lock */
+- (uint32_t)slotAtIndex:(NSUInteger)index
+{
+    return ((const uint32_t*)_status.bytes)[index];
+}
+
+- (NSString*)nameAtIndex:(NSUInteger)index
+{
+    @synchronized(self)
+    {
+        return index < _names.count ? _names[index] : nil;
+    }
+}
+
+- (NSInteger)statusAtIndex:(NSUInteger)index
+{
+    return [self errorAtIndex:index].code;
+}
+
+- (NSError*)errorAtIndex:(NSUInteger)index
+{
+    @synchronized(self)
+    {
+        if (index >= _names.count) {
+            return nil;
+        }
+        uint32_t slot = [self slotAtIndex:index];
+        return slot == kODMResultSuccess ? nil : _outcomes[slot];
+    }
+}
+
+- (NSArray*)namesMatching:(BOOL)succeeded
+{
+    @synchronized(self)
+    {
+        NSMutableArray* names = [NSMutableArray arrayWithCapacity:succeeded ? _names.count - _failureCount : _failureCount];
+        const uint32_t* status = _status.bytes;
+        for (NSUInteger i = 0; i < _names.count; i++) {
+            if ((status[i] == kODMResultSuccess) == succeeded) {
+                [names addObject:_names[i]];
+            }
+        }
+        return names;
+    }
+}
+
+- (NSArray*)succeededNames
+{
+    return [self namesMatching:YES];
+}
+
+- (NSArray*)failedNames
+{
+    return [self namesMatching:NO];
+}
+
+- (NSDictionary*)failuresByCode
+{
+    @synchronized(self)
+    {
+        NSMutableDictionary* failures = [NSMutableDictionary new];
+        const uint32_t* status = _status.bytes;
+        for (NSUInteger i = 0; i < _names.count; i++) {
+            if (status[i] == kODMResultSuccess) {
+                continue;
+            }
+            NSNumber* code = @([_outcomes[status[i]] code]);
+            NSMutableArray* names = failures[code];
+            if (!names) {
+                names = [NSMutableArray new];
+                failures[code] = names;
+            }
+            [names addObject:_names[i]];
+        }
+        return failures;
+    }
+}
+
+#pragma mark - Messages
+/* caller holds the lock */
+- (NSString*)messageForSlot:(uint32_t)slot
+{
+    NSString* message = [_outcomes[slot] localizedDescription];
+    return message ? message : @"";
+}
+
+- (NSString*)messageForCode:(NSInteger)code
+{
+    @synchronized(self)
+    {
+        for (uint32_t slot = 1; slot < _outcomes.count; slot++) {
+            if ([_outcomes[slot] code] == code) {
+                return [self messageForSlot:slot];
+            }
+        }
+        return nil;
+    }
+}
+
+- (NSString*)summary
+{
+    NSDictionary* failures = [self failuresByCode];
+    NSMutableString* summary = [NSMutableString stringWithFormat:@"%lu succeeded, %lu failed",
+                                                                 (unsigned long)self.successCount, (unsigned long)self.failureCount];
+    for (NSNumber* code in [failures.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+        [summary appendFormat:@" [%@: %lu]", code, (unsigned long)[failures[code] count]];
+    }
+    return summary;
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"ODManagerResult - %@", [self summary]];
+}
+
+#pragma mark - JSONL
+- (BOOL)writeJSONLinesToStream:(NSOutputStream*)stream error:(NSError* __autoreleasing*)error
+{
+    NSUInteger count = self.count;
+    NSData* newline = [@"\n" dataUsingEncoding:NSUTF8StringEncoding];
+    for (NSUInteger i = 0; i < count; i++) {
+        @autoreleasepool
+        {
+            NSDictionary* line;
+            @synchronized(self)
+            {
+                uint32_t slot = [self slotAtIndex:i];
+                if (slot == kODMResultSuccess) {
+                    line = @{ @"name" : _names[i], @"status" : @0 };
+                } else {
+                    NSError* outcome = _outcomes[slot];
+                    line = @{ @"name" : _names[i],
+                              @"status" : @(outcome.code),
+                              @"domain" : outcome.domain,
+                              @"message" : [self messageForSlot:slot] };
+                }
+            }
+
+            NSData* data = [NSJSONSerialization dataWithJSONObject:line options:0 error:error];
+            if (!data || ![self write:data toStream:stream error:error] || ![self write:newline toStream:stream error:error]) {
+                return NO;
+            }
+        }
+    }
+    return YES;
+}
+
+- (BOOL)write:(NSData*)data toStream:(NSOutputStream*)stream error:(NSError* __autoreleasing*)error
+{
+    const uint8_t* bytes = data.bytes;
+    NSUInteger remaining = data.length;
+    while (remaining > 0) {
+        NSInteger written = [stream write:bytes maxLength:remaining];
+        if (written <= 0) {
+            if (error)
+                *error = stream.streamError;
+            return NO;
+        }
+        bytes += written;
+        remaining -= written;
+    }
+    return YES;
+}
+
+- (BOOL)writeJSONLinesToPath:(NSString*)path error:(NSError* __autoreleasing*)error
+{
+    NSOutputStream* stream = [NSOutputStream outputStreamToFileAtPath:path append:NO];
+    [stream open];
+    if (stream.streamStatus == NSStreamStatusError) {
+        if (error)
+            *error = stream.streamError;
+        return NO;
+    }
+    BOOL rc = [self writeJSONLinesToStream:stream error:error];
+    [stream close];
+    return rc;
+}
+
+@end
@@ -0,0 +1,84 @@
+//
+//  ODMembershipCache.h
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+@class ODNode;
+
+/**
+ *  Local copy of every group's users (by name, GUID and primary group) and nested groups with the transitive closure precomputed,
+ *  so effective membership checks don't go to the server.
+ *  @discussion nested groups that form a cycle are treated as one group; the cycles found are in -cycles.
+ */
+@interface ODMembershipCache : NSObject
+
+@property (strong) ODNode* node;
+
+/**
+ *  whether reload: has completed at least once
+ */
+@property (readonly, getter=isLoaded) BOOL loaded;
+
+/**
+ *  arrays of group names that nest each other
+ */
+@property (copy, readonly) NSArray* cycles;
+
+- (id)initWithNode:(ODNode*)node;
+
+/**
+ *  Read every group's GroupMembership, GroupMembers and NestedGroups and every user's PrimaryGroupID, then rebuild the closure
+ *  @discussion a user is a direct member of a group if it is named in GroupMembership, its GUID is in GroupMembers, or the group is its primary group, the same as the server's own membership check
+ *
+ *  @param error populated should error occur
+ *
+ *  @return YES for success, NO on failure.
+ */
+- (BOOL)reload:(NSError**)error;
+
+/**
+ *  whether the user belongs to the group directly or through any nested group
+ */
+- (BOOL)user:(NSString*)user isMemberOfGroup:(NSString*)group;
+
+/**
+ *  every group the user belongs to directly or through nesting
+ */
+- (NSSet*)effectiveGroupsForUser:(NSString*)user;
+
+/**
+ *  every user that belongs to the group directly or through nesting
+ */
+- (NSSet*)effectiveMembersOfGroup:(NSString*)group;
+
+/* keep the closure current after changes made through ODManager */
+- (void)addUsers:(NSArray*)users toGroup:(NSString*)group;
+- (void)removeUsers:(NSArray*)users fromGroup:(NSString*)group;
+- (void)removeAllUsersFromGroup:(NSString*)group;
+- (void)addGroup:(NSString*)child toGroup:(NSString*)parent;
+- (void)removeGroup:(NSString*)child fromGroup:(NSString*)parent;
+- (void)removeUser:(NSString*)user;
+- (void)removeGroup:(NSString*)group;
+
+@end
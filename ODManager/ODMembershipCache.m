@@ -0,0 +1,433 @@
+//
+//  ODMembershipCache.m
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "ODMembershipCache.h"
+#import "ODManagerRecord.h"
+#import "ODManagerError.h"
+#import <OpenDirectory/OpenDirectory.h>
+#import <pthread.h>
+
+@implementation ODMembershipCache {
+    pthread_rwlock_t _lock;
+
+    /* what the directory says */
+    NSMutableDictionary* _directUsers; // group -> users
+    NSMutableDictionary* _userDirectGroups; // user -> groups
+    NSMutableDictionary* _parents; // group -> groups it is nested in
+
+    /* derived */
+    NSDictionary* _ancestors; // group -> itself and every group it is nested in
+    NSMutableDictionary* _userGroups; // user -> effective groups
+    NSMutableDictionary* _groupMembers; // group -> effective users
+}
+
+- (id)init
+{
+    return [self initWithNode:nil];
+}
+
+- (id)initWithNode:(ODNode*)node
+{
+    self = [super init];
+    if (self) {
+        _node = node;
+        pthread_rwlock_init(&_lock, NULL);
+        _directUsers = [NSMutableDictionary new];
+        _userDirectGroups = [NSMutableDictionary new];
+        _parents = [NSMutableDictionary new];
+        _userGroups = [NSMutableDictionary new];
+        _groupMembers = [NSMutableDictionary new];
+        _ancestors = @{};
+        _cycles = @[];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_rwlock_destroy(&_lock);
+}
+
+#pragma mark - Load
+- (BOOL)reload:(NSError* __autoreleasing*)error
+{
+    NSDictionary* groups = [ODManagerRecord recordsOfType:kODRecordTypeGroups
+                                               attributes:@[ kODAttributeTypeRecordName,
+                                                             kODAttributeTypeGUID,
+                                                             kODAttributeTypePrimaryGroupID,
+                                                             kODAttributeTypeGroupMembership,
+                                                             kODAttributeTypeGroupMembers,
+                                                             kODAttributeTypeNestedGroups ]
+                                                     node:_node
+                                                    error:error];
+    if (!groups) {
+        return NO;
+    }
+    NSDictionary* users = [ODManagerRecord recordsOfType:kODRecordTypeUsers
+                                              attributes:@[ kODAttributeTypeRecordName,
+                                                            kODAttributeTypeGUID,
+                                                            kODAttributeTypePrimaryGroupID ]
+                                                    node:_node
+                                                   error:error];
+    if (!users) {
+        return NO;
+    }
+
+    NSMutableDictionary* names = [NSMutableDictionary dictionaryWithCapacity:groups.count];
+    NSMutableDictionary* gids = [NSMutableDictionary dictionaryWithCapacity:groups.count];
+    [groups enumerateKeysAndObjectsUsingBlock:^(NSString* name, ODRecord* record, BOOL* stop) {
+        NSString* guid = [[record valuesForAttribute:kODAttributeTypeGUID error:nil] lastObject];
+        if (guid) {
+            names[guid] = name;
+        }
+        NSString* gid = [[record valuesForAttribute:kODAttributeTypePrimaryGroupID error:nil] lastObject];
+        if (gid) {
+            gids[gid] = name;
+        }
+    }];
+
+    NSMutableDictionary* directUsers = [NSMutableDictionary dictionaryWithCapacity:groups.count];
+    NSMutableDictionary* userDirectGroups = [NSMutableDictionary new];
+    NSMutableDictionary* parents = [NSMutableDictionary new];
+
+    /* a user belongs to a group the same ways the server checks it: by name in GroupMembership,
+       by GUID in GroupMembers, or by having the group as its PrimaryGroupID */
+    NSMutableDictionary* userNames = [NSMutableDictionary dictionaryWithCapacity:users.count];
+    [users enumerateKeysAndObjectsUsingBlock:^(NSString* name, ODRecord* record, BOOL* stop) {
+        NSString* guid = [[record valuesForAttribute:kODAttributeTypeGUID error:nil] lastObject];
+        if (guid) {
+            userNames[guid] = name;
+        }
+        NSString* gid = [[record valuesForAttribute:kODAttributeTypePrimaryGroupID error:nil] lastObject];
+        NSString* group = gid ? gids[gid] : nil;
+        if (group) {
+            [self set:directUsers key:group add:name];
+            [self set:userDirectGroups key:name add:group];
+        }
+    }];
+
+    [groups enumerateKeysAndObjectsUsingBlock:^(NSString* name, ODRecord* record, BOOL* stop) {
+        if (!directUsers[name]) {
+            directUsers[name] = [NSMutableSet new];
+        }
+        for (NSString* user in [record valuesForAttribute:kODAttributeTypeGroupMembership error:nil]) {
+            [directUsers[name] addObject:user];
+            [self set:userDirectGroups key:user add:name];
+        }
+        for (NSString* guid in [record valuesForAttribute:kODAttributeTypeGroupMembers error:nil]) {
+            NSString* user = userNames[guid];
+            if (user) {
+                [directUsers[name] addObject:user];
+                [self set:userDirectGroups key:user add:name];
+            }
+        }
+        for (NSString* guid in [record valuesForAttribute:kODAttributeTypeNestedGroups error:nil]) {
+            NSString* child = names[guid];
+            if (child) {
+                [self set:parents key:child add:name];
+            }
+        }
+    }];
+
+    pthread_rwlock_wrlock(&_lock);
+    _directUsers = directUsers;
+    _userDirectGroups = userDirectGroups;
+    _parents = parents;
+    [self rebuildClosure];
+    _loaded = YES;
+    pthread_rwlock_unlock(&_lock);
+    return YES;
+}
+
+#pragma mark - Closure
+/* caller holds the write lock */
+- (void)rebuildClosure
+{
+    NSMutableSet* groups = [NSMutableSet setWithArray:_directUsers.allKeys];
+    [groups addObjectsFromArray:_parents.allKeys];
+    for (NSSet* parents in _parents.allValues) {
+        [groups unionSet:parents];
+    }
+
+    /* Tarjan over child -> parent edges hands back each set of mutually nested groups
+       only after every group above it, so parents' ancestors are always ready first */
+    NSMutableDictionary* index = [NSMutableDictionary dictionaryWithCapacity:groups.count];
+    NSMutableDictionary* lowlink = [NSMutableDictionary dictionaryWithCapacity:groups.count];
+    NSMutableArray* stack = [NSMutableArray new];
+    NSMutableSet* onStack = [NSMutableSet new];
+    NSMutableDictionary* ancestors = [NSMutableDictionary dictionaryWithCapacity:groups.count];
+    NSMutableArray* cycles = [NSMutableArray new];
+    NSUInteger counter = 0;
+
+    for (NSString* group in groups) {
+        if (!index[group]) {
+            [self connect:group index:index lowlink:lowlink stack:stack onStack:onStack counter:&counter ancestors:ancestors cycles:cycles];
+        }
+    }
+    _ancestors = ancestors;
+    _cycles = cycles;
+
+    _userGroups = [NSMutableDictionary dictionaryWithCapacity:_userDirectGroups.count];
+    _groupMembers = [NSMutableDictionary dictionaryWithCapacity:groups.count];
+    for (NSString* user in _userDirectGroups) {
+        NSSet* effective = [self effectiveGroupsFromDirect:_userDirectGroups[user]];
+        _userGroups[user] = effective;
+        for (NSString* group in effective) {
+            [self set:_groupMembers key:group add:user];
+        }
+    }
+}
+
+- (void)connect:(NSString*)group
+          index:(NSMutableDictionary*)index
+        lowlink:(NSMutableDictionary*)lowlink
+          stack:(NSMutableArray*)stack
+        onStack:(NSMutableSet*)onStack
+        counter:(NSUInteger*)counter
+      ancestors:(NSMutableDictionary*)ancestors
+         cycles:(NSMutableArray*)cycles
+{
+    index[group] = @(*counter);
+    lowlink[group] = @(*counter);
+    (*counter)++;
+    [stack addObject:group];
+    [onStack addObject:group];
+
+    BOOL selfNested = NO;
+    for (NSString* parent in _parents[group]) {
+        if ([parent isEqualToString:group]) {
+            selfNested = YES;
+        }
+        if (!index[parent]) {
+            [self connect:parent index:index lowlink:lowlink stack:stack onStack:onStack counter:counter ancestors:ancestors cycles:cycles];
+            lowlink[group] = @(MIN([lowlink[group] unsignedIntegerValue], [lowlink[parent] unsignedIntegerValue]));
+        } else if ([onStack containsObject:parent]) {
+            lowlink[group] = @(MIN([lowlink[group] unsignedIntegerValue], [index[parent] unsignedIntegerValue]));
+        }
+    }
+
+    if (![lowlink[group] isEqualToNumber:index[group]]) {
+        return;
+    }
+
+    NSMutableArray* component = [NSMutableArray new];
+    NSString* member;
+    do {
+        member = [stack lastObject];
+        [stack removeLastObject];
+        [onStack removeObject:member];
+        [component addObject:member];
+    } while (![member isEqualToString:group]);
+
+    if (component.count > 1 || selfNested) {
+        [cycles addObject:component];
+    }
+
+    NSMutableSet* closure = [NSMutableSet setWithArray:component];
+    for (NSString* child in component) {
+        for (NSString* parent in _parents[child]) {
+            NSSet* above = ancestors[parent];
+            if (above) {
+                [closure unionSet:above];
+            }
+        }
+    }
+
+    NSSet* shared = [closure copy];
+    for (NSString* child in component) {
+        ancestors[child] = shared;
+    }
+}
+
+- (NSSet*)effectiveGroupsFromDirect:(NSSet*)direct
+{
+    if (direct.count == 1) {
+        NSString* group = [direct anyObject];
+        return _ancestors[group] ? _ancestors[group] : [NSSet setWithObject:group];
+    }
+    NSMutableSet* effective = [NSMutableSet new];
+    for (NSString* group in direct) {
+        NSSet* above = _ancestors[group];
+        if (above) {
+            [effective unionSet:above];
+        } else {
+            [effective addObject:group];
+        }
+    }
+    return effective;
+}
+
+- (void)set:(NSMutableDictionary*)dictionary key:(NSString*)key add:(NSString*)value
+{
+    NSMutableSet* set = dictionary[key];
+    if (!set) {
+        set = [NSMutableSet new];
+        dictionary[key] = set;
+    }
+    [set addObject:value];
+}
+
+#pragma mark - Queries
+- (BOOL)user:(NSString*)user isMemberOfGroup:(NSString*)group
+{
+    if (!user || !group) {
+        return NO;
+    }
+    pthread_rwlock_rdlock(&_lock);
+    BOOL rc = [_userGroups[user] containsObject:group];
+    pthread_rwlock_unlock(&_lock);
+    return rc;
+}
+
+- (NSSet*)effectiveGroupsForUser:(NSString*)user
+{
+    if (!user) {
+        return nil;
+    }
+    pthread_rwlock_rdlock(&_lock);
+    NSSet* groups = [_userGroups[user] copy];
+    pthread_rwlock_unlock(&_lock);
+    return groups ? groups : [NSSet set];
+}
+
+- (NSSet*)effectiveMembersOfGroup:(NSString*)group
+{
+    if (!group) {
+        return nil;
+    }
+    pthread_rwlock_rdlock(&_lock);
+    NSSet* members = [_groupMembers[group] copy];
+    pthread_rwlock_unlock(&_lock);
+    return members ? members : [NSSet set];
+}
+
+#pragma mark - Incremental Updates
+- (void)addUsers:(NSArray*)users toGroup:(NSString*)group
+{
+    pthread_rwlock_wrlock(&_lock);
+    if (!_directUsers[group]) {
+        _directUsers[group] = [NSMutableSet new];
+    }
+    NSSet* above = _ancestors[group] ? _ancestors[group] : [NSSet setWithObject:group];
+    for (NSString* user in users) {
+        [_directUsers[group] addObject:user];
+        [self set:_userDirectGroups key:user add:group];
+
+        NSMutableSet* effective = [_userGroups[user] mutableCopy];
+        if (!effective) {
+            effective = [NSMutableSet new];
+        }
+        [effective unionSet:above];
+        _userGroups[user] = effective;
+        for (NSString* ancestor in above) {
+            [self set:_groupMembers key:ancestor add:user];
+        }
+    }
+    pthread_rwlock_unlock(&_lock);
+}
+
+- (void)removeUsers:(NSArray*)users fromGroup:(NSString*)group
+{
+    pthread_rwlock_wrlock(&_lock);
+    for (NSString* user in users) {
+        [_directUsers[group] removeObject:user];
+        [_userDirectGroups[user] removeObject:group];
+        [self refreshUser:user];
+    }
+    pthread_rwlock_unlock(&_lock);
+}
+
+- (void)removeAllUsersFromGroup:(NSString*)group
+{
+    pthread_rwlock_wrlock(&_lock);
+    for (NSString* user in [_directUsers[group] copy]) {
+        [_directUsers[group] removeObject:user];
+        [_userDirectGroups[user] removeObject:group];
+        [self refreshUser:user];
+    }
+    pthread_rwlock_unlock(&_lock);
+}
+
+- (void)removeUser:(NSString*)user
+{
+    pthread_rwlock_wrlock(&_lock);
+    for (NSString* group in _userDirectGroups[user]) {
+        [_directUsers[group] removeObject:user];
+    }
+    [_userDirectGroups removeObjectForKey:user];
+    [self refreshUser:user];
+    pthread_rwlock_unlock(&_lock);
+}
+
+/* a user can still reach a group through another path, so work it out again from the direct groups */
+- (void)refreshUser:(NSString*)user
+{
+    NSSet* before = _userGroups[user];
+    NSSet* after = [_userDirectGroups[user] count] ? [self effectiveGroupsFromDirect:_userDirectGroups[user]] : nil;
+
+    for (NSString* group in before) {
+        if (![after containsObject:group]) {
+            [_groupMembers[group] removeObject:user];
+        }
+    }
+    if (after) {
+        _userGroups[user] = after;
+    } else {
+        [_userGroups removeObjectForKey:user];
+    }
+}
+
+- (void)addGroup:(NSString*)child toGroup:(NSString*)parent
+{
+    pthread_rwlock_wrlock(&_lock);
+    [self set:_parents key:child add:parent];
+    [self rebuildClosure];
+    pthread_rwlock_unlock(&_lock);
+}
+
+- (void)removeGroup:(NSString*)child fromGroup:(NSString*)parent
+{
+    pthread_rwlock_wrlock(&_lock);
+    [_parents[child] removeObject:parent];
+    [self rebuildClosure];
+    pthread_rwlock_unlock(&_lock);
+}
+
+- (void)removeGroup:(NSString*)group
+{
+    pthread_rwlock_wrlock(&_lock);
+    for (NSString* user in _directUsers[group]) {
+        [_userDirectGroups[user] removeObject:group];
+    }
+    [_directUsers removeObjectForKey:group];
+    [_parents removeObjectForKey:group];
+    for (NSMutableSet* parents in _parents.allValues) {
+        [parents removeObject:group];
+    }
+    [self rebuildClosure];
+    pthread_rwlock_unlock(&_lock);
+}
+
+@end
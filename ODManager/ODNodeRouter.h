@@ -0,0 +1,76 @@
+//
+//  ODNodeRouter.h
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+@class ODNode, ODManagerQuery;
+
+/**
+ *  Spreads reads over a set of replica nodes, sending each one to the replica with the fewest reads in flight.
+ *  @discussion writes are never routed here, they always go to the master node.
+ */
+@interface ODNodeRouter : NSObject
+
+@property (copy, readonly) NSArray* replicaNodes;
+
+/**
+ *  names of the servers the replica nodes were opened from, in the same order
+ */
+@property (copy, readonly) NSArray* servers;
+
+- (id)initWithReplicas:(NSArray*)replicas;
+- (id)initWithReplicas:(NSArray*)replicas servers:(NSArray*)servers;
+
+/**
+ *  Take the replica with the fewest outstanding reads, every checkout must be matched by checkinReadNode:
+ */
+- (ODNode*)checkoutReadNode;
+- (void)checkinReadNode:(ODNode*)node;
+
+/**
+ *  Run a read against the least busy replica
+ *
+ *  @param block block that performs the read on the node it is given
+ *
+ *  @return whatever the block returns
+ */
+- (id)read:(id (^)(ODNode* node))block;
+
+/**
+ *  number of reads currently running on a replica
+ */
+- (NSUInteger)outstandingReadsForNode:(ODNode*)node;
+
+/**
+ *  Run a query against several nodes at once and merge the results
+ *
+ *  @param query query to run, the GUID is added to its return attributes so records can be matched up
+ *  @param nodes nodes to query
+ *  @param error populated with the last error if every node failed
+ *
+ *  @return attribute dictionaries, one per GUID (or record name when there is no GUID), in node order
+ */
++ (NSArray*)fanOutQuery:(ODManagerQuery*)query nodes:(NSArray*)nodes error:(NSError**)error;
+
+@end
@@ -0,0 +1,191 @@
+//
+//  ODNodeRouter.m
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "ODNodeRouter.h"
+#import "ODManagerQuery.h"
+#import "ODManagerError.h"
+#import <OpenDirectory/OpenDirectory.h>
+#import <pthread.h>
+
+@implementation ODNodeRouter {
+    pthread_mutex_t _lock;
+    NSUInteger* _outstanding; // reads in flight, same order as _replicaNodes
+    NSUInteger _next; // where the search for the least busy replica starts, so ties rotate
+}
+
+- (id)init
+{
+    return [self initWithReplicas:nil];
+}
+
+- (id)initWithReplicas:(NSArray*)replicas
+{
+    return [self initWithReplicas:replicas servers:nil];
+}
+
+- (id)initWithReplicas:(NSArray*)replicas servers:(NSArray*)servers
+{
+    self = [super init];
+    if (self) {
+        _replicaNodes = [replicas copy];
+        _servers = [servers copy];
+        _outstanding = calloc(MAX(_replicaNodes.count, 1), sizeof(NSUInteger));
+        pthread_mutex_init(&_lock, NULL);
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_lock);
+    free(_outstanding);
+}
+
+#pragma mark - Reads
+- (ODNode*)checkoutReadNode
+{
+    NSUInteger count = _replicaNodes.count;
+    if (!count) {
+        return nil;
+    }
+
+    pthread_mutex_lock(&_lock);
+    NSUInteger best = _next % count;
+    for (NSUInteger i = 1; i < count; i++) {
+        NSUInteger candidate = (_next + i) % count;
+        if (_outstanding[candidate] < _outstanding[best]) {
+            best = candidate;
+        }
+    }
+    _outstanding[best]++;
+    _next = best + 1;
+    pthread_mutex_unlock(&_lock);
+
+    return _replicaNodes[best];
+}
+
+- (void)checkinReadNode:(ODNode*)node
+{
+    NSUInteger index = [_replicaNodes indexOfObjectIdenticalTo:node];
+    if (index == NSNotFound) {
+        return;
+    }
+    pthread_mutex_lock(&_lock);
+    if (_outstanding[index]) {
+        _outstanding[index]--;
+    }
+    pthread_mutex_unlock(&_lock);
+}
+
+- (id)read:(id (^)(ODNode*))block
+{
+    ODNode* node = [self checkoutReadNode];
+    id result = block(node);
+    [self checkinReadNode:node];
+    return result;
+}
+
+- (NSUInteger)outstandingReadsForNode:(ODNode*)node
+{
+    NSUInteger index = [_replicaNodes indexOfObjectIdenticalTo:node];
+    if (index == NSNotFound) {
+        return 0;
+    }
+    pthread_mutex_lock(&_lock);
+    NSUInteger outstanding = _outstanding[index];
+    pthread_mutex_unlock(&_lock);
+    return outstanding;
+}
+
+#pragma mark - Fan Out
++ (NSArray*)fanOutQuery:(ODManagerQuery*)query nodes:(NSArray*)nodes error:(NSError* __autoreleasing*)error
+{
+    if (!nodes.count) {
+        [ODManagerError errorWithCode:kODMerrNoDirectoryNode error:error];
+        return nil;
+    }
+
+    ODManagerQuery* withGUID = [ODManagerQuery queryForType:query.recordType predicate:query.predicate];
+    withGUID.limit = query.limit;
+    if (query.returnAttributes && ![query.returnAttributes containsObject:kODAttributeTypeGUID]) {
+        withGUID.returnAttributes = [query.returnAttributes arrayByAddingObject:kODAttributeTypeGUID];
+    } else {
+        withGUID.returnAttributes = query.returnAttributes;
+    }
+
+    NSMutableArray* perNode = [NSMutableArray arrayWithCapacity:nodes.count];
+    for (NSUInteger i = 0; i < nodes.count; i++) {
+        [perNode addObject:[NSNull null]];
+    }
+    __block NSError* lastError;
+
+    dispatch_apply(nodes.count, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        NSError* nodeError;
+        NSArray* results = [withGUID resultsWithNode:nodes[i] error:&nodeError];
+        @synchronized(perNode)
+        {
+            if (results) {
+                perNode[i] = results;
+            } else {
+                lastError = nodeError;
+            }
+        }
+    });
+
+    NSMutableArray* merged = [NSMutableArray new];
+    NSMutableSet* seen = [NSMutableSet new];
+    BOOL answered = NO;
+    for (id results in perNode) {
+        if (results == [NSNull null]) {
+            continue;
+        }
+        answered = YES;
+        for (NSDictionary* record in results) {
+            NSString* key = [record[kODAttributeTypeGUID] firstObject];
+            if (!key) {
+                key = [record[kODAttributeTypeRecordName] firstObject];
+            }
+            if (key && [seen containsObject:key]) {
+                continue;
+            }
+            if (key) {
+                [seen addObject:key];
+            }
+            [merged addObject:record];
+            if (query.limit && merged.count >= query.limit) {
+                return merged;
+            }
+        }
+    }
+
+    if (!answered) {
+        if (error)
+            *error = lastError;
+        return nil;
+    }
+    return merged;
+}
+
+@end
@@ -0,0 +1,77 @@
+//
+//  ODPresetTemplate.h
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+#import "ODSecureObjects.h"
+@class ODNode, ODRecord;
+
+/**
+ *  Preset record compiled once into the attribute values every user created from it shares.
+ *  @discussion templates are immutable and cached per node and preset name.  The cache entry is replaced when the preset record's modification timestamp changes.
+ */
+@interface ODPresetTemplate : NSObject
+
+@property (copy, readonly) NSString* presetName;
+@property (copy, readonly) NSString* userShell;
+@property (copy, readonly) NSString* primaryGroup;
+@property (copy, readonly) NSString* nfsPath;
+@property (copy, readonly) NSString* sharePath;
+@property (copy, readonly) NSString* sharePoint;
+@property (copy, readonly) NSString* modificationTimestamp;
+
+/**
+ *  Cached template for a preset, recompiled if the preset record changed
+ *
+ *  @param preset preset record name
+ *  @param node   node the preset lives on
+ *  @param error  populated should error occur
+ *
+ *  @return compiled template, nil if the preset could not be found
+ */
++ (ODPresetTemplate*)templateForPreset:(NSString*)preset node:(ODNode*)node error:(NSError**)error;
+
+/**
+ *  Drop a single preset from the cache
+ */
++ (void)invalidatePreset:(NSString*)preset;
+
+/**
+ *  Drop every cached preset
+ */
++ (void)invalidateCache;
+
+- (id)initWithRecord:(ODRecord*)record;
+
+/**
+ *  Open Directory attributes for a user created from this preset
+ *  @discussion the preset's shell, primary group and share fields and the generated uid are written back to the user, as copying the preset onto it used to.  A home directory set on the user is used as is when the preset has a share point
+ *
+ *  @param user populated user object
+ *
+ *  @return attribute dictionary suitable for -[ODNode createRecordWithRecordType:name:attributes:error:]
+ */
+- (NSDictionary*)attributesForUser:(ODUser*)user;
+
+@end
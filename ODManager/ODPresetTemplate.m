@@ -0,0 +1,207 @@
+//
+//  ODPresetTemplate.m
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "ODPresetTemplate.h"
+#import "ODManagerRecord.h"
+#import "ODManagerError.h"
+#import <OpenDirectory/OpenDirectory.h>
+
+static NSString* const kODMDefaultUserShell = @"/bin/null";
+static NSString* const kODMDefaultPrimaryGroup = @"20";
+
+@implementation ODPresetTemplate {
+    /* values that are the same for every user, already wrapped in arrays */
+    NSDictionary* _sharedAttributes;
+    NSString* _nfsPrefix;
+    NSString* _homePrefix;
+    NSString* _homeSuffix;
+}
+
+#pragma mark - Cache
++ (NSMutableDictionary*)cache
+{
+    static dispatch_once_t onceToken;
+    static NSMutableDictionary* cache;
+    dispatch_once(&onceToken, ^{
+        cache = [NSMutableDictionary new];
+    });
+    return cache;
+}
+
++ (ODPresetTemplate*)templateForPreset:(NSString*)preset node:(ODNode*)node error:(NSError* __autoreleasing*)error
+{
+    ODRecord* record = [ODManagerRecord getPresetRecord:preset node:node error:error];
+    if (!record) {
+        [ODManagerError errorWithCode:kODMerrNoPresetRecord error:error];
+        return nil;
+    }
+
+    NSString* key = [NSString stringWithFormat:@"%@:%@", node.nodeName, preset];
+    NSString* stamp = [[record valuesForAttribute:kODAttributeTypeModificationTimestamp error:nil] lastObject];
+    NSMutableDictionary* cache = [self cache];
+
+    ODPresetTemplate* presetTemplate;
+    @synchronized(cache)
+    {
+        presetTemplate = cache[key];
+    }
+
+    /* without a timestamp there is no way to tell if it changed, so always recompile */
+    if (presetTemplate && stamp && [presetTemplate.modificationTimestamp isEqualToString:stamp]) {
+        return presetTemplate;
+    }
+
+    presetTemplate = [[ODPresetTemplate alloc] initWithRecord:record];
+    @synchronized(cache)
+    {
+        cache[key] = presetTemplate;
+    }
+    return presetTemplate;
+}
+
++ (void)invalidatePreset:(NSString*)preset
+{
+    NSMutableDictionary* cache = [self cache];
+    NSString* suffix = [@":" stringByAppendingString:preset];
+    @synchronized(cache)
+    {
+        for (NSString* key in cache.allKeys) {
+            if ([key hasSuffix:suffix]) {
+                [cache removeObjectForKey:key];
+            }
+        }
+    }
+}
+
++ (void)invalidateCache
+{
+    NSMutableDictionary* cache = [self cache];
+    @synchronized(cache)
+    {
+        [cache removeAllObjects];
+    }
+}
+
+#pragma mark - Compile
+- (id)initWithRecord:(ODRecord*)record
+{
+    self = [super init];
+    if (self) {
+        _presetName = record.recordName;
+        _userShell = record.userShell ? record.userShell : kODMDefaultUserShell;
+        _primaryGroup = record.primaryGroup ? record.primaryGroup : kODMDefaultPrimaryGroup;
+        _nfsPath = record.NFSHomeDirectory;
+        _sharePath = record.sharePath;
+        _sharePoint = record.sharePoint;
+        _modificationTimestamp = [[record valuesForAttribute:kODAttributeTypeModificationTimestamp error:nil] lastObject];
+        [self compile];
+    }
+    return self;
+}
+
+- (void)compile
+{
+    _sharedAttributes = @{
+        @"dsAttrTypeStandard:UserShell" : @[ _userShell ],
+        @"dsAttrTypeStandard:PrimaryGroupID" : @[ _primaryGroup ],
+    };
+
+    if (_nfsPath) {
+        _nfsPrefix = [[self class] prefixForAppendingPathComponentTo:_nfsPath];
+    }
+
+    if (_sharePoint) {
+        NSMutableString* prefix = [NSMutableString stringWithFormat:@"<home_dir><url>%@</url><path>", _sharePoint];
+        if (_sharePath) {
+            [prefix appendString:[[self class] prefixForAppendingPathComponentTo:_sharePath]];
+        }
+        _homePrefix = [prefix copy];
+        _homeSuffix = @"</path></home_dir>";
+    }
+}
+
+/* whatever stringByAppendingPathComponent: would put in front of the user name, so appending the
+   name to the prefix gives the same path ODUser builds; the path itself is not standardized */
++ (NSString*)prefixForAppendingPathComponentTo:(NSString*)path
+{
+    NSString* joined = [path stringByAppendingPathComponent:@"_"];
+    return [joined substringToIndex:joined.length - 1];
+}
+
+#pragma mark - Per User
+- (NSDictionary*)attributesForUser:(ODUser*)user
+{
+    NSString* userName = user.userName;
+    NSString* firstName = user.firstName;
+    NSString* lastName = user.lastName;
+    NSString* uid = user.uid;
+    if (!uid) {
+        uid = [userName uuidWithLength:6];
+    }
+
+    /* with no share point the getter only returns a home directory that was set explicitly */
+    user.sharePoint = nil;
+    NSString* explicitHome = user.homeDirectory;
+
+    /* the user ends up looking as it did when the preset fields were copied onto it */
+    user.uid = uid;
+    user.userShell = _userShell;
+    user.primaryGroup = _primaryGroup;
+    user.nfsPath = _nfsPath;
+    user.sharePath = _sharePath;
+    user.sharePoint = _sharePoint;
+
+    NSMutableDictionary* settings = [_sharedAttributes mutableCopy];
+    if (_nfsPrefix) {
+        settings[@"dsAttrTypeStandard:NFSHomeDirectory"] = @[ [_nfsPrefix stringByAppendingString:userName] ];
+    }
+    if (_homePrefix && explicitHome) {
+        settings[@"dsAttrTypeStandard:HomeDirectory"] = @[ explicitHome ];
+    } else if (_homePrefix) {
+        NSMutableString* home = [[NSMutableString alloc] initWithCapacity:_homePrefix.length + userName.length + _homeSuffix.length];
+        [home appendString:_homePrefix];
+        [home appendString:userName];
+        [home appendString:_homeSuffix];
+        settings[@"dsAttrTypeStandard:HomeDirectory"] = @[ home ];
+    }
+    if (user.emailDomain) {
+        NSMutableString* email = [userName mutableCopy];
+        [email appendString:@"@"];
+        [email appendString:user.emailDomain];
+        settings[@"dsAttrTypeStandard:EMailAddress"] = @[ email ];
+    }
+
+    NSMutableString* realName = [firstName mutableCopy];
+    [realName appendString:@" "];
+    [realName appendString:lastName];
+    settings[@"dsAttrTypeStandard:RealName"] = @[ realName ];
+    settings[@"dsAttrTypeStandard:FirstName"] = @[ firstName ];
+    settings[@"dsAttrTypeStandard:LastName"] = @[ lastName ];
+    settings[@"dsAttrTypeStandard:UniqueID"] = @[ uid ];
+
+    return settings;
+}
+
+@end
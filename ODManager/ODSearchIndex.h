@@ -0,0 +1,90 @@
+//
+//  ODSearchIndex.h
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+@class ODNode;
+
+/**
+ *  Local index of user and group names for as-you-type completion.
+ *  @discussion record names, RealName, each word of RealName and email addresses are folded for case and diacritics and kept in one sorted array per record type, so a completion is a binary search and a short forward walk.
+ */
+@interface ODSearchIndex : NSObject
+
+@property (strong) ODNode* node;
+
+/**
+ *  whether reload: has completed at least once
+ */
+@property (readonly, getter=isLoaded) BOOL loaded;
+
+- (id)initWithNode:(ODNode*)node;
+
+/**
+ *  Read every user and group with the indexed attributes in one query per type and replace the index
+ *
+ *  @param error populated should error occur
+ *
+ *  @return YES for success, NO on failure.
+ */
+- (BOOL)reload:(NSError**)error;
+
+/**
+ *  Record names whose indexed values start with a prefix
+ *
+ *  @param type   kODRecordTypeUsers or kODRecordTypeGroups
+ *  @param prefix text typed so far
+ *  @param limit  maximum number of names, 0 for no limit
+ *
+ *  @return unique record names in index order
+ */
+- (NSArray*)namesOfType:(NSString*)type withPrefix:(NSString*)prefix limit:(NSUInteger)limit;
+
+/**
+ *  Add or replace a single record without reloading
+ */
+- (void)setValues:(NSArray*)values forName:(NSString*)name type:(NSString*)type;
+
+/**
+ *  Remove a single record without reloading
+ */
+- (void)removeName:(NSString*)name type:(NSString*)type;
+
+/**
+ *  Add or replace many records in one pass over the index
+ *
+ *  @param valuesByName record name -> array of values to index besides the name
+ *  @param type         kODRecordTypeUsers or kODRecordTypeGroups
+ *  @discussion use this rather than setValues:forName:type: in a loop, each call copies the index once
+ */
+- (void)setValuesByName:(NSDictionary*)valuesByName type:(NSString*)type;
+
+/**
+ *  Remove many records in one pass over the index
+ */
+- (void)removeNames:(NSArray*)names type:(NSString*)type;
+
++ (NSString*)foldedString:(NSString*)string;
+
+@end
@@ -0,0 +1,281 @@
+//
+//  ODSearchIndex.m
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "ODSearchIndex.h"
+#import "ODManagerRecord.h"
+#import <OpenDirectory/OpenDirectory.h>
+
+/* sorted folded keys and the record name each key belongs to, at the same index */
+@interface ODSearchTable : NSObject
+@property (copy) NSArray* keys;
+@property (copy) NSArray* names;
+@end
+
+@implementation ODSearchTable
+@end
+
+@implementation ODSearchIndex {
+    NSDictionary* _tables; // record type -> ODSearchTable
+}
+
+- (id)init
+{
+    return [self initWithNode:nil];
+}
+
+- (id)initWithNode:(ODNode*)node
+{
+    self = [super init];
+    if (self) {
+        _node = node;
+        _tables = @{};
+    }
+    return self;
+}
+
++ (NSArray*)indexedAttributesForType:(NSString*)type
+{
+    if ([type isEqualToString:kODRecordTypeUsers]) {
+        return @[ kODAttributeTypeRecordName, kODAttributeTypeFullName, kODAttributeTypeEMailAddress ];
+    }
+    return @[ kODAttributeTypeRecordName, kODAttributeTypeFullName ];
+}
+
++ (NSString*)foldedString:(NSString*)string
+{
+    return [string stringByFoldingWithOptions:NSCaseInsensitiveSearch | NSDiacriticInsensitiveSearch locale:nil];
+}
+
+#pragma mark - Load
+- (BOOL)reload:(NSError* __autoreleasing*)error
+{
+    NSMutableDictionary* tables = [NSMutableDictionary new];
+    for (NSString* type in @[ kODRecordTypeUsers, kODRecordTypeGroups ]) {
+        NSArray* attributes = [[self class] indexedAttributesForType:type];
+        NSDictionary* records = [ODManagerRecord recordsOfType:type attributes:attributes node:_node error:error];
+        if (!records) {
+            return NO;
+        }
+
+        NSMutableDictionary* values = [NSMutableDictionary dictionaryWithCapacity:records.count];
+        [records enumerateKeysAndObjectsUsingBlock:^(NSString* name, ODRecord* record, BOOL* stop) {
+            NSMutableArray* recordValues = [NSMutableArray arrayWithObject:name];
+            for (NSString* attribute in attributes) {
+                if (![attribute isEqualToString:kODAttributeTypeRecordName]) {
+                    NSArray* found = [record valuesForAttribute:attribute error:nil];
+                    if (found) {
+                        [recordValues addObjectsFromArray:found];
+                    }
+                }
+            }
+            values[name] = recordValues;
+        }];
+        tables[type] = [self tableWithValues:values];
+    }
+
+    @synchronized(self)
+    {
+        _tables = tables;
+        _loaded = YES;
+    }
+    return YES;
+}
+
+- (ODSearchTable*)tableWithValues:(NSDictionary*)values
+{
+    NSMutableArray* entries = [NSMutableArray arrayWithCapacity:values.count * 3];
+    [values enumerateKeysAndObjectsUsingBlock:^(NSString* name, NSArray* recordValues, BOOL* stop) {
+        for (NSString* key in [self keysForValues:recordValues]) {
+            [entries addObject:@[ key, name ]];
+        }
+    }];
+    [entries sortUsingComparator:^NSComparisonResult(NSArray* a, NSArray* b) {
+        NSComparisonResult rc = [a[0] compare:b[0] options:NSLiteralSearch];
+        return rc != NSOrderedSame ? rc : [a[1] compare:b[1] options:NSLiteralSearch];
+    }];
+
+    NSMutableArray* keys = [NSMutableArray arrayWithCapacity:entries.count];
+    NSMutableArray* names = [NSMutableArray arrayWithCapacity:entries.count];
+    for (NSArray* entry in entries) {
+        [keys addObject:entry[0]];
+        [names addObject:entry[1]];
+    }
+
+    ODSearchTable* table = [ODSearchTable new];
+    table.keys = keys;
+    table.names = names;
+    return table;
+}
+
+/* each whole value, plus every later word so "smi" finds "John Smith" */
+- (NSSet*)keysForValues:(NSArray*)values
+{
+    NSMutableSet* keys = [NSMutableSet new];
+    NSCharacterSet* separators = [NSCharacterSet whitespaceCharacterSet];
+    for (NSString* value in values) {
+        if (![value isKindOfClass:[NSString class]] || !value.length) {
+            continue;
+        }
+        NSString* folded = [[self class] foldedString:value];
+        [keys addObject:folded];
+        for (NSString* word in [folded componentsSeparatedByCharactersInSet:separators]) {
+            if (word.length) {
+                [keys addObject:word];
+            }
+        }
+    }
+    return keys;
+}
+
+#pragma mark - Search
+- (NSArray*)namesOfType:(NSString*)type withPrefix:(NSString*)prefix limit:(NSUInteger)limit
+{
+    ODSearchTable* table;
+    @synchronized(self)
+    {
+        table = _tables[type];
+    }
+    if (!table || !prefix) {
+        return @[];
+    }
+
+    NSString* folded = [[self class] foldedString:prefix];
+    NSArray* keys = table.keys;
+    NSUInteger start = [keys indexOfObject:folded
+                             inSortedRange:NSMakeRange(0, keys.count)
+                                   options:NSBinarySearchingFirstEqual | NSBinarySearchingInsertionIndex
+                           usingComparator:^NSComparisonResult(NSString* a, NSString* b) {
+                               return [a compare:b options:NSLiteralSearch];
+                           }];
+
+    NSMutableOrderedSet* names = [NSMutableOrderedSet new];
+    for (NSUInteger i = start; i < keys.count; i++) {
+        if (![keys[i] hasPrefix:folded]) {
+            break;
+        }
+        [names addObject:table.names[i]];
+        if (limit && names.count == limit) {
+            break;
+        }
+    }
+    return names.array;
+}
+
+#pragma mark - Updates
+- (void)setValues:(NSArray*)values forName:(NSString*)name type:(NSString*)type
+{
+    if (name) {
+        [self setValuesByName:@{ name : values ? values : @[] } type:type];
+    }
+}
+
+- (void)removeName:(NSString*)name type:(NSString*)type
+{
+    if (name) {
+        [self removeNames:@[ name ] type:type];
+    }
+}
+
+- (void)setValuesByName:(NSDictionary*)valuesByName type:(NSString*)type
+{
+    NSMutableDictionary* recordValues = [NSMutableDictionary dictionaryWithCapacity:valuesByName.count];
+    [valuesByName enumerateKeysAndObjectsUsingBlock:^(NSString* name, NSArray* values, BOOL* stop) {
+        recordValues[name] = [@[ name ] arrayByAddingObjectsFromArray:values];
+    }];
+    [self updateValuesByName:recordValues type:type];
+}
+
+- (void)removeNames:(NSArray*)names type:(NSString*)type
+{
+    NSMutableDictionary* removed = [NSMutableDictionary dictionaryWithCapacity:names.count];
+    for (NSString* name in names) {
+        removed[name] = [NSNull null];
+    }
+    [self updateValuesByName:removed type:type];
+}
+
+static NSComparisonResult ODSearchCompareEntries(NSString* keyA, NSString* nameA, NSString* keyB, NSString* nameB)
+{
+    NSComparisonResult rc = [keyA compare:keyB options:NSLiteralSearch];
+    return rc != NSOrderedSame ? rc : [nameA compare:nameB options:NSLiteralSearch];
+}
+
+/* A whole batch costs one pass over the table: entries of every changed name are dropped and the
+   batch's new keys, sorted on their own outside the lock, are merged in as the walk goes.
+   NSNull values remove a name. */
+- (void)updateValuesByName:(NSDictionary*)valuesByName type:(NSString*)type
+{
+    if (!valuesByName.count) {
+        return;
+    }
+
+    NSMutableArray* entries = [NSMutableArray new];
+    [valuesByName enumerateKeysAndObjectsUsingBlock:^(NSString* name, id values, BOOL* stop) {
+        if ([values isKindOfClass:[NSArray class]]) {
+            for (NSString* key in [self keysForValues:values]) {
+                [entries addObject:@[ key, name ]];
+            }
+        }
+    }];
+    [entries sortUsingComparator:^NSComparisonResult(NSArray* a, NSArray* b) {
+        return ODSearchCompareEntries(a[0], a[1], b[0], b[1]);
+    }];
+
+    @synchronized(self)
+    {
+        ODSearchTable* table = _tables[type];
+        NSArray* oldKeys = table.keys;
+        NSArray* oldNames = table.names;
+        NSMutableArray* keys = [NSMutableArray arrayWithCapacity:oldKeys.count + entries.count];
+        NSMutableArray* names = [NSMutableArray arrayWithCapacity:oldKeys.count + entries.count];
+
+        NSUInteger next = 0;
+        for (NSUInteger i = 0; i < oldKeys.count; i++) {
+            if (valuesByName[oldNames[i]]) {
+                continue;
+            }
+            while (next < entries.count && ODSearchCompareEntries(entries[next][0], entries[next][1], oldKeys[i], oldNames[i]) == NSOrderedAscending) {
+                [keys addObject:entries[next][0]];
+                [names addObject:entries[next][1]];
+                next++;
+            }
+            [keys addObject:oldKeys[i]];
+            [names addObject:oldNames[i]];
+        }
+        for (; next < entries.count; next++) {
+            [keys addObject:entries[next][0]];
+            [names addObject:entries[next][1]];
+        }
+
+        ODSearchTable* updated = [ODSearchTable new];
+        updated.keys = keys;
+        updated.names = names;
+        NSMutableDictionary* tables = [_tables mutableCopy];
+        tables[type] = updated;
+        _tables = tables;
+    }
+}
+
+@end
@@ -71,7 +71,12 @@
 @property (copy) NSString *groupName;
 @property (copy) NSString *fullName;
 @property (copy) NSString *guid;
+@property (copy) NSString *gid;
 @property (copy) NSString *owner;
+/**
+ *  user record names that belong in the group, nil when membership is not managed
+ */
+@property (copy) NSArray *members;
 @end
 
 
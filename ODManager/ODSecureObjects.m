@@ -103,7 +103,7 @@
 }
 
 - (id)initWithCoder:(NSCoder*)aDecoder {
-    NSSet *whiteList = [NSSet setWithObjects:[NSArray class],[ODUser class],[NSString class], nil];
+    NSSet *whiteList = [NSSet setWithObjects:[NSArray class],[ODUser class],[ODGroup class],[NSString class], nil];
     self = [super init];
     if (self) {
         _users = [aDecoder decodeObjectOfClasses: whiteList forKey:@"users"];
@@ -129,6 +129,11 @@
     self = [super init];
     if (self) {
         _groupName = [aDecoder decodeObjectOfClasses: whiteList forKey:@"groupName"];
+        _fullName = [aDecoder decodeObjectOfClass:[NSString class] forKey:@"fullName"];
+        _guid = [aDecoder decodeObjectOfClass:[NSString class] forKey:@"guid"];
+        _gid = [aDecoder decodeObjectOfClass:[NSString class] forKey:@"gid"];
+        _owner = [aDecoder decodeObjectOfClass:[NSString class] forKey:@"owner"];
+        _members = [aDecoder decodeObjectOfClasses: whiteList forKey:@"members"];
     }
     return self;
 }
@@ -137,7 +142,15 @@
 
 - (void)encodeWithCoder:(NSCoder*)aEncoder {
     [aEncoder encodeObject:_groupName forKey:@"groupName"];
-    
+    [aEncoder encodeObject:_fullName forKey:@"fullName"];
+    [aEncoder encodeObject:_guid forKey:@"guid"];
+    [aEncoder encodeObject:_gid forKey:@"gid"];
+    [aEncoder encodeObject:_owner forKey:@"owner"];
+    [aEncoder encodeObject:_members forKey:@"members"];
+}
+
+-(NSString *)description{
+    return [NSString stringWithFormat:@"groupname: %@",_groupName];
 }
 @end
 
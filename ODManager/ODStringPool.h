@@ -0,0 +1,68 @@
+//
+//  ODStringPool.h
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ *  Thread safe pool that hands back one shared instance for equal strings.
+ *  @discussion attribute values such as the login shell, primary group or home directory prefix repeat across almost every record, interning them while records are materialized keeps one copy instead of one per record.
+ */
+@interface ODStringPool : NSObject
+
+/**
+ *  number of intern: calls
+ */
+@property (readonly) NSUInteger lookups;
+
+/**
+ *  number of intern: calls answered with a string already in the pool
+ */
+@property (readonly) NSUInteger hits;
+
+/**
+ *  number of distinct strings held
+ */
+@property (readonly) NSUInteger count;
+
+/**
+ *  estimate of the character bytes not allocated thanks to hits
+ */
+@property (readonly) NSUInteger bytesSaved;
+
+/**
+ *  The pooled instance equal to a string, adding an immutable copy if there isn't one yet
+ *
+ *  @param string string to intern, may be nil
+ *
+ *  @return shared instance, nil if string is nil
+ */
+- (NSString*)intern:(NSString*)string;
+
+/**
+ *  Drop every pooled string and reset the counters
+ */
+- (void)removeAllStrings;
+
+@end
@@ -0,0 +1,122 @@
+//
+//  ODStringPool.m
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "ODStringPool.h"
+#import <pthread.h>
+
+@implementation ODStringPool {
+    pthread_mutex_t _lock;
+    NSMutableSet* _strings;
+    NSUInteger _lookups;
+    NSUInteger _hits;
+    NSUInteger _bytesSaved;
+}
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&_lock, NULL);
+        _strings = [NSMutableSet new];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_lock);
+}
+
+- (NSString*)intern:(NSString*)string
+{
+    if (!string) {
+        return nil;
+    }
+
+    pthread_mutex_lock(&_lock);
+    _lookups++;
+    NSString* pooled = [_strings member:string];
+    if (pooled) {
+        _hits++;
+        _bytesSaved += pooled.length * sizeof(unichar);
+    } else {
+        pooled = [string copy];
+        [_strings addObject:pooled];
+    }
+    pthread_mutex_unlock(&_lock);
+    return pooled;
+}
+
+- (void)removeAllStrings
+{
+    pthread_mutex_lock(&_lock);
+    [_strings removeAllObjects];
+    _lookups = 0;
+    _hits = 0;
+    _bytesSaved = 0;
+    pthread_mutex_unlock(&_lock);
+}
+
+#pragma mark - Stats
+- (NSUInteger)lookups
+{
+    pthread_mutex_lock(&_lock);
+    NSUInteger lookups = _lookups;
+    pthread_mutex_unlock(&_lock);
+    return lookups;
+}
+
+- (NSUInteger)hits
+{
+    pthread_mutex_lock(&_lock);
+    NSUInteger hits = _hits;
+    pthread_mutex_unlock(&_lock);
+    return hits;
+}
+
+- (NSUInteger)count
+{
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = _strings.count;
+    pthread_mutex_unlock(&_lock);
+    return count;
+}
+
+- (NSUInteger)bytesSaved
+{
+    pthread_mutex_lock(&_lock);
+    NSUInteger bytesSaved = _bytesSaved;
+    pthread_mutex_unlock(&_lock);
+    return bytesSaved;
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"ODStringPool - %lu strings, %lu/%lu hits, ~%lu bytes saved",
+                                      (unsigned long)self.count, (unsigned long)self.hits,
+                                      (unsigned long)self.lookups, (unsigned long)self.bytesSaved];
+}
+
+@end
@@ -0,0 +1,121 @@
+//
+//  ODLoadBackend.h
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ *  Kinds of server round trip, each with its own profile
+ */
+typedef NS_ENUM(NSInteger, ODLoadOperation) {
+    kODLoadAuthenticate = 0,
+    kODLoadQuery,
+    kODLoadLookup,
+    kODLoadCreate,
+    kODLoadModify,
+    kODLoadDelete,
+    kODLoadPassword,
+    kODLoadOperationCount
+};
+
+extern NSString* const ODLoadErrorDomain;
+extern NSString* ODLoadOperationName(ODLoadOperation operation);
+
+/**
+ *  Latency, error rate and throughput limit of one kind of round trip
+ */
+@interface ODLoadProfile : NSObject
+
+/**
+ *  median added latency in milliseconds
+ */
+@property double median;
+
+/**
+ *  99th percentile added latency in milliseconds, latencies follow a log-normal through median and p99
+ */
+@property double p99;
+
+/**
+ *  fraction of calls, 0 to 1, that fail without reaching the node
+ */
+@property double errorRate;
+
+/**
+ *  calls per second the backend lets through, later calls wait their turn.  0 for no limit
+ */
+@property double maxPerSecond;
+
++ (ODLoadProfile*)profileWithMedian:(double)median p99:(double)p99 errorRate:(double)errorRate;
+
+/**
+ *  one latency draw in seconds
+ */
+- (NSTimeInterval)sampleLatency;
+
+@end
+
+/**
+ *  Turns a local node into a stand-in for a remote directory server.
+ *  @discussion Once installed, every ODNode, ODRecord and ODQuery call that ODManager makes first waits out a latency drawn
+ *  from the profile for its kind of round trip, waits for a throttle slot, and may fail with an injected error before reaching the node.
+ *  OpenDirectory only accepts real nodes, so point ODManager at a local node or a local LDAP server and let the profiles supply the distance.
+ *  Queries are only delayed when their results are read synchronously; queries scheduled on a run loop, which the batched lists use, are not slowed or failed.
+ */
+@interface ODLoadBackend : NSObject
+
++ (ODLoadBackend*)sharedBackend;
+
+/**
+ *  interpose the OpenDirectory calls, safe to call more than once
+ */
+- (void)install;
+
+/**
+ *  profiles start out with no latency, no errors and no limit
+ */
+- (ODLoadProfile*)profileForOperation:(ODLoadOperation)operation;
+- (void)setProfile:(ODLoadProfile*)profile forOperation:(ODLoadOperation)operation;
+
+/**
+ *  the same profile for every kind of round trip
+ */
+- (void)setProfile:(ODLoadProfile*)profile;
+
+/**
+ *  Called before each interposed round trip
+ *
+ *  @param operation kind of round trip
+ *  @param error     populated with the injected error
+ *
+ *  @return NO when the call should fail without reaching the node
+ */
+- (BOOL)willPerform:(ODLoadOperation)operation error:(NSError**)error;
+
+- (NSUInteger)callsForOperation:(ODLoadOperation)operation;
+- (NSUInteger)injectedErrorsForOperation:(ODLoadOperation)operation;
+- (NSUInteger)throttledCallsForOperation:(ODLoadOperation)operation;
+- (void)resetCounters;
+
+@end
@@ -0,0 +1,377 @@
+//
+//  ODLoadBackend.m
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "ODLoadBackend.h"
+#import <OpenDirectory/OpenDirectory.h>
+#import <objc/runtime.h>
+#import <pthread.h>
+
+NSString* const ODLoadErrorDomain = @"ODLoadErrorDomain";
+
+NSString* ODLoadOperationName(ODLoadOperation operation)
+{
+    switch (operation) {
+    case kODLoadAuthenticate:
+        return @"authenticate";
+    case kODLoadQuery:
+        return @"query";
+    case kODLoadLookup:
+        return @"lookup";
+    case kODLoadCreate:
+        return @"create";
+    case kODLoadModify:
+        return @"modify";
+    case kODLoadDelete:
+        return @"delete";
+    case kODLoadPassword:
+        return @"password";
+    default:
+        return @"unknown";
+    }
+}
+
+/* uniform in (0, 1) */
+static double ODLoadUniform(void)
+{
+    return (arc4random_uniform(UINT32_MAX - 1) + 1.0) / UINT32_MAX;
+}
+
+@implementation ODLoadProfile
+
++ (ODLoadProfile*)profileWithMedian:(double)median p99:(double)p99 errorRate:(double)errorRate
+{
+    ODLoadProfile* profile = [ODLoadProfile new];
+    profile.median = median;
+    profile.p99 = p99;
+    profile.errorRate = errorRate;
+    return profile;
+}
+
+- (NSTimeInterval)sampleLatency
+{
+    if (_median <= 0) {
+        return 0;
+    }
+    if (_p99 <= _median) {
+        return _median / 1000;
+    }
+    /* 2.326 is the standard normal's 99th percentile */
+    double sigma = log(_p99 / _median) / 2.326;
+    double z = sqrt(-2 * log(ODLoadUniform())) * cos(2 * M_PI * ODLoadUniform());
+    return _median * exp(sigma * z) / 1000;
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"median %.1fms p99 %.1fms errors %.2f%% limit %.0f/s",
+                                      _median, _p99, _errorRate * 100, _maxPerSecond];
+}
+
+@end
+
+@implementation ODLoadBackend {
+    pthread_mutex_t _lock;
+    ODLoadProfile* _profiles[kODLoadOperationCount];
+    NSTimeInterval _nextSlot[kODLoadOperationCount];
+    NSUInteger _calls[kODLoadOperationCount];
+    NSUInteger _injected[kODLoadOperationCount];
+    NSUInteger _throttled[kODLoadOperationCount];
+}
+
++ (ODLoadBackend*)sharedBackend
+{
+    static dispatch_once_t onceToken;
+    static ODLoadBackend* shared;
+    dispatch_once(&onceToken, ^{
+        shared = [[ODLoadBackend alloc] init];
+    });
+    return shared;
+}
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        pthread_mutex_init(&_lock, NULL);
+        for (NSInteger i = 0; i < kODLoadOperationCount; i++) {
+            _profiles[i] = [ODLoadProfile new];
+        }
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_lock);
+}
+
+#pragma mark - Profiles
+- (ODLoadProfile*)profileForOperation:(ODLoadOperation)operation
+{
+    pthread_mutex_lock(&_lock);
+    ODLoadProfile* profile = _profiles[operation];
+    pthread_mutex_unlock(&_lock);
+    return profile;
+}
+
+- (void)setProfile:(ODLoadProfile*)profile forOperation:(ODLoadOperation)operation
+{
+    pthread_mutex_lock(&_lock);
+    _profiles[operation] = profile ? profile : [ODLoadProfile new];
+    _nextSlot[operation] = 0;
+    pthread_mutex_unlock(&_lock);
+}
+
+- (void)setProfile:(ODLoadProfile*)profile
+{
+    for (NSInteger i = 0; i < kODLoadOperationCount; i++) {
+        [self setProfile:profile forOperation:i];
+    }
+}
+
+#pragma mark - Injection
+- (BOOL)willPerform:(ODLoadOperation)operation error:(NSError* __autoreleasing*)error
+{
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    NSTimeInterval wait = 0;
+
+    pthread_mutex_lock(&_lock);
+    ODLoadProfile* profile = _profiles[operation];
+    _calls[operation]++;
+
+    /* each call takes the next slot in the operation's schedule */
+    if (profile.maxPerSecond > 0) {
+        NSTimeInterval slot = MAX(now, _nextSlot[operation]);
+        _nextSlot[operation] = slot + 1 / profile.maxPerSecond;
+        wait = slot - now;
+        if (wait > 0) {
+            _throttled[operation]++;
+        }
+    }
+    BOOL fail = profile.errorRate > 0 && ODLoadUniform() < profile.errorRate;
+    if (fail) {
+        _injected[operation]++;
+    }
+    pthread_mutex_unlock(&_lock);
+
+    wait += [profile sampleLatency];
+    if (wait > 0) {
+        [NSThread sleepForTimeInterval:wait];
+    }
+
+    if (fail && error) {
+        *error = [NSError errorWithDomain:ODLoadErrorDomain
+                                     code:operation
+                                 userInfo:@{ NSLocalizedDescriptionKey : [NSString stringWithFormat:@"Injected %@ failure", ODLoadOperationName(operation)] }];
+    }
+    return !fail;
+}
+
+#pragma mark - Counters
+- (NSUInteger)callsForOperation:(ODLoadOperation)operation
+{
+    pthread_mutex_lock(&_lock);
+    NSUInteger calls = _calls[operation];
+    pthread_mutex_unlock(&_lock);
+    return calls;
+}
+
+- (NSUInteger)injectedErrorsForOperation:(ODLoadOperation)operation
+{
+    pthread_mutex_lock(&_lock);
+    NSUInteger injected = _injected[operation];
+    pthread_mutex_unlock(&_lock);
+    return injected;
+}
+
+- (NSUInteger)throttledCallsForOperation:(ODLoadOperation)operation
+{
+    pthread_mutex_lock(&_lock);
+    NSUInteger throttled = _throttled[operation];
+    pthread_mutex_unlock(&_lock);
+    return throttled;
+}
+
+- (void)resetCounters
+{
+    pthread_mutex_lock(&_lock);
+    for (NSInteger i = 0; i < kODLoadOperationCount; i++) {
+        _calls[i] = 0;
+        _injected[i] = 0;
+        _throttled[i] = 0;
+    }
+    pthread_mutex_unlock(&_lock);
+}
+
+#pragma mark - Interposing
+- (void)install
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        [self interposeNode];
+        [self interposeRecord];
+        [self interposeQuery];
+    });
+}
+
+/* the backend is a singleton, so the blocks below hold it for the life of the process */
+- (void)interposeNode
+{
+    ODLoadBackend* backend = self;
+    Method method;
+
+    method = class_getInstanceMethod([ODNode class], @selector(setCredentialsWithRecordType:recordName:password:error:));
+    BOOL (*setCredentials)(id, SEL, NSString*, NSString*, NSString*, NSError**) = (void*)method_getImplementation(method);
+    SEL setCredentialsSEL = method_getName(method);
+    method_setImplementation(method, imp_implementationWithBlock(^BOOL(id node, NSString* type, NSString* name, NSString* password, NSError** error) {
+        if (![backend willPerform:kODLoadAuthenticate error:error]) {
+            return NO;
+        }
+        return setCredentials(node, setCredentialsSEL, type, name, password, error);
+    }));
+
+    method = class_getInstanceMethod([ODNode class], @selector(createRecordWithRecordType:name:attributes:error:));
+    id (*createRecord)(id, SEL, NSString*, NSString*, NSDictionary*, NSError**) = (void*)method_getImplementation(method);
+    SEL createRecordSEL = method_getName(method);
+    method_setImplementation(method, imp_implementationWithBlock(^id(id node, NSString* type, NSString* name, NSDictionary* attributes, NSError** error) {
+        if (![backend willPerform:kODLoadCreate error:error]) {
+            return nil;
+        }
+        return createRecord(node, createRecordSEL, type, name, attributes, error);
+    }));
+
+    method = class_getInstanceMethod([ODNode class], @selector(recordWithRecordType:name:attributes:error:));
+    id (*recordWithType)(id, SEL, NSString*, NSString*, id, NSError**) = (void*)method_getImplementation(method);
+    SEL recordWithTypeSEL = method_getName(method);
+    method_setImplementation(method, imp_implementationWithBlock(^id(id node, NSString* type, NSString* name, id attributes, NSError** error) {
+        if (![backend willPerform:kODLoadLookup error:error]) {
+            return nil;
+        }
+        return recordWithType(node, recordWithTypeSEL, type, name, attributes, error);
+    }));
+
+    method = class_getInstanceMethod([ODNode class], @selector(nodeDetailsForKeys:error:));
+    id (*nodeDetails)(id, SEL, NSArray*, NSError**) = (void*)method_getImplementation(method);
+    SEL nodeDetailsSEL = method_getName(method);
+    method_setImplementation(method, imp_implementationWithBlock(^id(id node, NSArray* keys, NSError** error) {
+        if (![backend willPerform:kODLoadLookup error:error]) {
+            return nil;
+        }
+        return nodeDetails(node, nodeDetailsSEL, keys, error);
+    }));
+}
+
+- (void)interposeRecord
+{
+    ODLoadBackend* backend = self;
+    Method method;
+
+    method = class_getInstanceMethod([ODRecord class], @selector(deleteRecordAndReturnError:));
+    BOOL (*deleteRecord)(id, SEL, NSError**) = (void*)method_getImplementation(method);
+    SEL deleteRecordSEL = method_getName(method);
+    method_setImplementation(method, imp_implementationWithBlock(^BOOL(id record, NSError** error) {
+        if (![backend willPerform:kODLoadDelete error:error]) {
+            return NO;
+        }
+        return deleteRecord(record, deleteRecordSEL, error);
+    }));
+
+    method = class_getInstanceMethod([ODRecord class], @selector(changePassword:toPassword:error:));
+    BOOL (*changePassword)(id, SEL, NSString*, NSString*, NSError**) = (void*)method_getImplementation(method);
+    SEL changePasswordSEL = method_getName(method);
+    method_setImplementation(method, imp_implementationWithBlock(^BOOL(id record, NSString* oldPassword, NSString* newPassword, NSError** error) {
+        if (![backend willPerform:kODLoadPassword error:error]) {
+            return NO;
+        }
+        return changePassword(record, changePasswordSEL, oldPassword, newPassword, error);
+    }));
+
+    method = class_getInstanceMethod([ODRecord class], @selector(setValue:forAttribute:error:));
+    BOOL (*setValue)(id, SEL, id, NSString*, NSError**) = (void*)method_getImplementation(method);
+    SEL setValueSEL = method_getName(method);
+    method_setImplementation(method, imp_implementationWithBlock(^BOOL(id record, id value, NSString* attribute, NSError** error) {
+        if (![backend willPerform:kODLoadModify error:error]) {
+            return NO;
+        }
+        return setValue(record, setValueSEL, value, attribute, error);
+    }));
+
+    method = class_getInstanceMethod([ODRecord class], @selector(removeValuesForAttribute:error:));
+    BOOL (*removeValues)(id, SEL, NSString*, NSError**) = (void*)method_getImplementation(method);
+    SEL removeValuesSEL = method_getName(method);
+    method_setImplementation(method, imp_implementationWithBlock(^BOOL(id record, NSString* attribute, NSError** error) {
+        if (![backend willPerform:kODLoadModify error:error]) {
+            return NO;
+        }
+        return removeValues(record, removeValuesSEL, attribute, error);
+    }));
+
+    method = class_getInstanceMethod([ODRecord class], @selector(addMemberRecord:error:));
+    BOOL (*addMember)(id, SEL, ODRecord*, NSError**) = (void*)method_getImplementation(method);
+    SEL addMemberSEL = method_getName(method);
+    method_setImplementation(method, imp_implementationWithBlock(^BOOL(id record, ODRecord* member, NSError** error) {
+        if (![backend willPerform:kODLoadModify error:error]) {
+            return NO;
+        }
+        return addMember(record, addMemberSEL, member, error);
+    }));
+
+    method = class_getInstanceMethod([ODRecord class], @selector(isMemberRecord:error:));
+    BOOL (*isMember)(id, SEL, ODRecord*, NSError**) = (void*)method_getImplementation(method);
+    SEL isMemberSEL = method_getName(method);
+    method_setImplementation(method, imp_implementationWithBlock(^BOOL(id record, ODRecord* member, NSError** error) {
+        if (![backend willPerform:kODLoadLookup error:error]) {
+            return NO;
+        }
+        return isMember(record, isMemberSEL, member, error);
+    }));
+
+    method = class_getInstanceMethod([ODRecord class], @selector(removeMemberRecord:error:));
+    BOOL (*removeMember)(id, SEL, ODRecord*, NSError**) = (void*)method_getImplementation(method);
+    SEL removeMemberSEL = method_getName(method);
+    method_setImplementation(method, imp_implementationWithBlock(^BOOL(id record, ODRecord* member, NSError** error) {
+        if (![backend willPerform:kODLoadModify error:error]) {
+            return NO;
+        }
+        return removeMember(record, removeMemberSEL, member, error);
+    }));
+}
+
+/* only synchronous results are delayed, run-loop queries deliver at the node's own pace */
+- (void)interposeQuery
+{
+    ODLoadBackend* backend = self;
+    Method method = class_getInstanceMethod([ODQuery class], @selector(resultsAllowingPartial:error:));
+    id (*results)(id, SEL, BOOL, NSError**) = (void*)method_getImplementation(method);
+    SEL resultsSEL = method_getName(method);
+    method_setImplementation(method, imp_implementationWithBlock(^id(id query, BOOL partial, NSError** error) {
+        if (![backend willPerform:kODLoadQuery error:error]) {
+            return nil;
+        }
+        return results(query, resultsSEL, partial, error);
+    }));
+}
+
+@end
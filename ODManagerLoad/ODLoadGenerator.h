@@ -0,0 +1,117 @@
+//
+//  ODLoadGenerator.h
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+@class ODManager;
+
+/* workloads for the mix */
+extern NSString* const kODLoadWorkloadImport;
+extern NSString* const kODLoadWorkloadSync;
+extern NSString* const kODLoadWorkloadList;
+extern NSString* const kODLoadWorkloadCheck;
+
+/**
+ *  Drives a mixed workload through the public ODManager API and measures it.
+ *  @discussion seed: fills the directory with users and groups, run drives the mix, cleanUp: removes everything the generator created.
+ *  Every call is timed; report has throughput, latency percentiles, errors and memory for each workload.
+ */
+@interface ODLoadGenerator : NSObject
+
+@property (strong, readonly) ODManager* manager;
+
+/**
+ *  prefix of every record name the generator creates, defaults to odmload
+ */
+@property (copy) NSString* prefix;
+
+/**
+ *  users and groups seeded, default 100000 and 10000
+ */
+@property NSUInteger users;
+@property NSUInteger groups;
+
+/**
+ *  users seeded into each group, default 25
+ */
+@property NSUInteger membersPerGroup;
+
+/**
+ *  users per import in the mix, default 50
+ */
+@property NSUInteger importBatchSize;
+
+/**
+ *  workload calls in flight at once, default 8
+ */
+@property NSUInteger concurrency;
+
+/**
+ *  workload calls made by run, default 10000
+ */
+@property NSUInteger operations;
+
+/**
+ *  workload name -> relative weight, defaults to import 1, sync 2, list 1, check 6
+ */
+@property (copy) NSDictionary* mix;
+
+- (id)initWithManager:(ODManager*)manager;
+
+/**
+ *  Create the users and groups, through addListOfUsers and addGroups
+ *
+ *  @param error populated should error occur
+ *
+ *  @return YES for success, NO on failure.
+ */
+- (BOOL)seed:(NSError**)error;
+
+/**
+ *  Make operations calls picked from the mix, concurrency at a time, and wait for them all
+ */
+- (void)run;
+
+/**
+ *  Remove every user and group the generator created
+ *
+ *  @param error populated should error occur
+ *
+ *  @return YES for success, NO on failure.
+ */
+- (BOOL)cleanUp:(NSError**)error;
+
+/**
+ *  workload name -> count, errors, seconds, throughput and latency percentiles in milliseconds
+ */
+- (NSDictionary*)statistics;
+
+/**
+ *  statistics as a table, plus resident memory and the backend's counters
+ */
+- (NSString*)report;
+
+- (void)resetStatistics;
+
+@end
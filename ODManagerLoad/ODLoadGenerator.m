@@ -0,0 +1,526 @@
+//
+//  ODLoadGenerator.m
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import "ODLoadGenerator.h"
+#import "ODLoadBackend.h"
+#import <ODManager/ODManager.h>
+#import <OpenDirectory/OpenDirectory.h>
+#import <mach/mach.h>
+#import <pthread.h>
+
+NSString* const kODLoadWorkloadImport = @"import";
+NSString* const kODLoadWorkloadSync = @"sync";
+NSString* const kODLoadWorkloadList = @"list";
+NSString* const kODLoadWorkloadCheck = @"check";
+
+/* seeding goes in chunks so progress shows; user chunks run several at once, group chunks one at a time */
+static NSUInteger const kODLoadSeedUserChunk = 1000;
+static NSUInteger const kODLoadSeedGroupChunk = 500;
+static NSUInteger const kODLoadSyncUsers = 5;
+static NSUInteger const kODLoadListLimit = 500;
+
+static uint64_t ODLoadResidentBytes(void)
+{
+    struct mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return info.resident_size;
+}
+
+#pragma mark - Samples
+/* latencies of one workload, kept as a flat array of doubles */
+@interface ODLoadSamples : NSObject
+@property (readonly) NSUInteger count;
+@property (readonly) NSUInteger errors;
+@property (readonly) NSTimeInterval first;
+@property (readonly) NSTimeInterval last;
+- (void)addLatency:(NSTimeInterval)latency at:(NSTimeInterval)end failed:(BOOL)failed;
+- (NSDictionary*)summary;
+@end
+
+@implementation ODLoadSamples {
+    NSMutableData* _latencies;
+}
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        _latencies = [NSMutableData new];
+    }
+    return self;
+}
+
+/* caller serializes */
+- (void)addLatency:(NSTimeInterval)latency at:(NSTimeInterval)end failed:(BOOL)failed
+{
+    [_latencies appendBytes:&latency length:sizeof(latency)];
+    if (!_count || end - latency < _first) {
+        _first = end - latency;
+    }
+    _last = MAX(_last, end);
+    _count++;
+    if (failed) {
+        _errors++;
+    }
+}
+
+static int ODLoadCompareLatency(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+- (NSDictionary*)summary
+{
+    NSMutableData* sorted = [_latencies mutableCopy];
+    double* values = sorted.mutableBytes;
+    qsort(values, _count, sizeof(double), ODLoadCompareLatency);
+
+    double (^percentile)(double) = ^double(double p) {
+        if (!_count) {
+            return 0;
+        }
+        NSUInteger index = MIN(_count - 1, (NSUInteger)ceil(p * _count) - (p > 0 ? 1 : 0));
+        return values[index] * 1000;
+    };
+
+    NSTimeInterval elapsed = _last - _first;
+    return @{ @"count" : @(_count),
+              @"errors" : @(_errors),
+              @"seconds" : @(elapsed),
+              @"throughput" : @(elapsed > 0 ? _count / elapsed : 0),
+              @"p50" : @(percentile(0.50)),
+              @"p95" : @(percentile(0.95)),
+              @"p99" : @(percentile(0.99)),
+              @"p999" : @(percentile(0.999)),
+              @"max" : @(percentile(1.0)) };
+}
+
+@end
+
+#pragma mark - Generator
+@implementation ODLoadGenerator {
+    pthread_mutex_t _lock;
+    NSMutableDictionary* _samples;
+    NSMutableArray* _imported;
+    NSUInteger _importCounter;
+    uint64_t _peakResident;
+    dispatch_source_t _memoryTimer;
+}
+
+- (id)init
+{
+    return [self initWithManager:nil];
+}
+
+- (id)initWithManager:(ODManager*)manager
+{
+    self = [super init];
+    if (self) {
+        _manager = manager;
+        _prefix = @"odmload";
+        _users = 100000;
+        _groups = 10000;
+        _membersPerGroup = 25;
+        _importBatchSize = 50;
+        _concurrency = 8;
+        _operations = 10000;
+        _mix = @{ kODLoadWorkloadImport : @1,
+                  kODLoadWorkloadSync : @2,
+                  kODLoadWorkloadList : @1,
+                  kODLoadWorkloadCheck : @6 };
+        pthread_mutex_init(&_lock, NULL);
+        _samples = [NSMutableDictionary new];
+        _imported = [NSMutableArray new];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [self stopSamplingMemory];
+    pthread_mutex_destroy(&_lock);
+}
+
+#pragma mark - Names
+- (NSString*)userAtIndex:(NSUInteger)index
+{
+    return [NSString stringWithFormat:@"%@u%lu", _prefix, (unsigned long)index];
+}
+
+- (NSString*)groupAtIndex:(NSUInteger)index
+{
+    return [NSString stringWithFormat:@"%@g%lu", _prefix, (unsigned long)index];
+}
+
+- (ODUser*)newUserNamed:(NSString*)name
+{
+    ODUser* user = [ODUser new];
+    user.userName = name;
+    user.firstName = @"Load";
+    user.lastName = name;
+    user.passWord = [[NSUUID UUID] UUIDString];
+    user.primaryGroup = @"20";
+    return user;
+}
+
+#pragma mark - Timing
+- (void)record:(NSString*)workload latency:(NSTimeInterval)latency failed:(BOOL)failed
+{
+    NSTimeInterval end = [NSDate timeIntervalSinceReferenceDate];
+    pthread_mutex_lock(&_lock);
+    ODLoadSamples* samples = _samples[workload];
+    if (!samples) {
+        samples = [ODLoadSamples new];
+        _samples[workload] = samples;
+    }
+    [samples addLatency:latency at:end failed:failed];
+    pthread_mutex_unlock(&_lock);
+}
+
+- (BOOL)time:(NSString*)workload block:(BOOL (^)(void))block
+{
+    NSTimeInterval start = [NSDate timeIntervalSinceReferenceDate];
+    BOOL rc = block();
+    [self record:workload latency:[NSDate timeIntervalSinceReferenceDate] - start failed:!rc];
+    return rc;
+}
+
+- (void)startSamplingMemory
+{
+    if (_memoryTimer) {
+        return;
+    }
+    _memoryTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0));
+    dispatch_source_set_timer(_memoryTimer, DISPATCH_TIME_NOW, 100 * NSEC_PER_MSEC, 10 * NSEC_PER_MSEC);
+    __weak ODLoadGenerator* weakSelf = self;
+    dispatch_source_set_event_handler(_memoryTimer, ^{
+        [weakSelf sampleMemory];
+    });
+    dispatch_resume(_memoryTimer);
+}
+
+- (void)stopSamplingMemory
+{
+    if (_memoryTimer) {
+        dispatch_source_cancel(_memoryTimer);
+        _memoryTimer = nil;
+    }
+    [self sampleMemory];
+}
+
+- (void)sampleMemory
+{
+    uint64_t resident = ODLoadResidentBytes();
+    pthread_mutex_lock(&_lock);
+    _peakResident = MAX(_peakResident, resident);
+    pthread_mutex_unlock(&_lock);
+}
+
+#pragma mark - Seed
+- (BOOL)seed:(NSError* __autoreleasing*)error
+{
+    [self startSamplingMemory];
+    NSOperationQueue* queue = [NSOperationQueue new];
+    queue.maxConcurrentOperationCount = _concurrency;
+    __block NSError* err;
+
+    for (NSUInteger start = 0; start < _users; start += kODLoadSeedUserChunk) {
+        NSUInteger end = MIN(_users, start + kODLoadSeedUserChunk);
+        [queue addOperationWithBlock:^{
+            ODRecordList* list = [ODRecordList new];
+            NSMutableArray* users = [NSMutableArray arrayWithCapacity:end - start];
+            for (NSUInteger i = start; i < end; i++) {
+                [users addObject:[self newUserNamed:[self userAtIndex:i]]];
+            }
+            list.users = users;
+            [self time:@"seed.users" block:^BOOL {
+                NSError* importError = [self waitForImport:list];
+                if (importError) {
+                    @synchronized(queue)
+                    {
+                        err = importError;
+                    }
+                }
+                return importError == nil;
+            }];
+        }];
+    }
+    [queue waitUntilAllOperationsAreFinished];
+
+    /* addGroups: picks GIDs and writes memberships per call, concurrent chunks would only
+       contend on the allocator and on the same member records, so groups go in one chunk at a time */
+    queue.maxConcurrentOperationCount = 1;
+    for (NSUInteger start = 0; start < _groups; start += kODLoadSeedGroupChunk) {
+        NSUInteger end = MIN(_groups, start + kODLoadSeedGroupChunk);
+        [queue addOperationWithBlock:^{
+            ODRecordList* list = [ODRecordList new];
+            NSMutableArray* groups = [NSMutableArray arrayWithCapacity:end - start];
+            for (NSUInteger i = start; i < end; i++) {
+                ODGroup* group = [ODGroup new];
+                group.groupName = [self groupAtIndex:i];
+                group.fullName = group.groupName;
+                NSMutableArray* members = [NSMutableArray arrayWithCapacity:_membersPerGroup];
+                for (NSUInteger m = 0; _users && m < _membersPerGroup; m++) {
+                    [members addObject:[self userAtIndex:(i * _membersPerGroup + m) % _users]];
+                }
+                group.members = members;
+                [groups addObject:group];
+            }
+            list.groups = groups;
+            [self time:@"seed.groups" block:^BOOL {
+                NSError* groupError;
+                BOOL rc = [_manager addGroups:list error:&groupError];
+                if (!rc) {
+                    @synchronized(queue)
+                    {
+                        err = groupError;
+                    }
+                }
+                return rc;
+            }];
+        }];
+    }
+    [queue waitUntilAllOperationsAreFinished];
+    [self stopSamplingMemory];
+
+    if (error) {
+        *error = err;
+    }
+    return err == nil;
+}
+
+- (NSError*)waitForImport:(ODRecordList*)list
+{
+    dispatch_semaphore_t done = dispatch_semaphore_create(0);
+    __block NSError* importError;
+    ODManagerJob* job = [_manager addListOfUsers:list
+                                        progress:nil
+                                           reply:^(NSError* error) {
+                                               importError = error;
+                                               dispatch_semaphore_signal(done);
+                                           }];
+    /* no job means the reply has already run */
+    if (job) {
+        dispatch_semaphore_wait(done, DISPATCH_TIME_FOREVER);
+    }
+    return importError;
+}
+
+#pragma mark - Run
+- (NSString*)pickWorkload
+{
+    double total = 0;
+    for (NSNumber* weight in _mix.allValues) {
+        total += weight.doubleValue;
+    }
+    double pick = arc4random_uniform(UINT32_MAX) / (double)UINT32_MAX * total;
+    for (NSString* workload in _mix) {
+        pick -= [_mix[workload] doubleValue];
+        if (pick < 0) {
+            return workload;
+        }
+    }
+    return _mix.allKeys.lastObject;
+}
+
+- (void)run
+{
+    [self startSamplingMemory];
+    NSOperationQueue* queue = [NSOperationQueue new];
+    queue.maxConcurrentOperationCount = _concurrency;
+
+    for (NSUInteger i = 0; i < _operations; i++) {
+        NSString* workload = [self pickWorkload];
+        [queue addOperationWithBlock:^{
+            [self time:workload block:^BOOL {
+                return [self perform:workload];
+            }];
+        }];
+    }
+    [queue waitUntilAllOperationsAreFinished];
+    [self stopSamplingMemory];
+}
+
+- (BOOL)perform:(NSString*)workload
+{
+    NSUInteger user = _users ? arc4random_uniform((uint32_t)_users) : 0;
+    NSUInteger group = _groups ? arc4random_uniform((uint32_t)_groups) : 0;
+
+    if ([workload isEqualToString:kODLoadWorkloadImport]) {
+        ODRecordList* list = [ODRecordList new];
+        NSMutableArray* users = [NSMutableArray arrayWithCapacity:_importBatchSize];
+        pthread_mutex_lock(&_lock);
+        for (NSUInteger i = 0; i < _importBatchSize; i++) {
+            NSString* name = [NSString stringWithFormat:@"%@x%lu", _prefix, (unsigned long)_importCounter++];
+            [_imported addObject:name];
+            [users addObject:[self newUserNamed:name]];
+        }
+        pthread_mutex_unlock(&_lock);
+        list.users = users;
+        return [self waitForImport:list] == nil;
+    }
+
+    if ([workload isEqualToString:kODLoadWorkloadSync]) {
+        /* add a handful of members and take them out again, so the seeded membership stays put */
+        NSMutableArray* members = [NSMutableArray arrayWithCapacity:kODLoadSyncUsers];
+        for (NSUInteger i = 0; _users && i < kODLoadSyncUsers; i++) {
+            [members addObject:[self userAtIndex:arc4random_uniform((uint32_t)_users)]];
+        }
+        NSString* name = [self groupAtIndex:group];
+        return [_manager addUsers:members toGroup:name error:nil]
+               && [_manager removeUsers:members fromGroup:name error:nil];
+    }
+
+    if ([workload isEqualToString:kODLoadWorkloadList]) {
+        NSString* start = [NSString stringWithFormat:@"%@u%u", _prefix, arc4random_uniform(10)];
+        ODManagerQuery* query = [ODManagerQuery queryForType:kODRecordTypeUsers
+                                                   predicate:[ODManagerPredicate attribute:kODAttributeTypeRecordName
+                                                                                   matches:kODMMatchBeginsWith
+                                                                                     value:start]];
+        query.limit = kODLoadListLimit;
+        NSError* error;
+        return [_manager recordsMatchingQuery:query error:&error] != nil;
+    }
+
+    if ([workload isEqualToString:kODLoadWorkloadCheck]) {
+        NSError* error;
+        [_manager user:[self userAtIndex:user] isMemberOfGroup:[self groupAtIndex:group] error:&error];
+        return error == nil;
+    }
+    return NO;
+}
+
+#pragma mark - Clean Up
+- (BOOL)cleanUp:(NSError* __autoreleasing*)error
+{
+    NSMutableArray* users = [NSMutableArray arrayWithCapacity:_users];
+    for (NSUInteger i = 0; i < _users; i++) {
+        [users addObject:[self userAtIndex:i]];
+    }
+    pthread_mutex_lock(&_lock);
+    [users addObjectsFromArray:_imported];
+    [_imported removeAllObjects];
+    pthread_mutex_unlock(&_lock);
+
+    NSMutableArray* groups = [NSMutableArray arrayWithCapacity:_groups];
+    for (NSUInteger i = 0; i < _groups; i++) {
+        [groups addObject:[self groupAtIndex:i]];
+    }
+
+    __block NSError* err;
+    [self time:@"cleanup.groups" block:^BOOL {
+        NSError* groupError;
+        BOOL rc = [_manager removeGroups:groups error:&groupError];
+        if (!rc) {
+            err = groupError;
+        }
+        return rc;
+    }];
+
+    [self time:@"cleanup.users" block:^BOOL {
+        dispatch_semaphore_t done = dispatch_semaphore_create(0);
+        __block NSError* removalError;
+        ODManagerJob* job = [_manager removeUsers:users
+                                 cleanMemberships:NO
+                                         progress:nil
+                                            reply:^(NSError* error) {
+                                                removalError = error;
+                                                dispatch_semaphore_signal(done);
+                                            }];
+        if (job) {
+            dispatch_semaphore_wait(done, DISPATCH_TIME_FOREVER);
+        }
+        if (removalError) {
+            err = removalError;
+        }
+        return removalError == nil;
+    }];
+
+    if (error) {
+        *error = err;
+    }
+    return err == nil;
+}
+
+#pragma mark - Report
+- (NSDictionary*)statistics
+{
+    NSMutableDictionary* statistics = [NSMutableDictionary new];
+    pthread_mutex_lock(&_lock);
+    [_samples enumerateKeysAndObjectsUsingBlock:^(NSString* workload, ODLoadSamples* samples, BOOL* stop) {
+        statistics[workload] = [samples summary];
+    }];
+    pthread_mutex_unlock(&_lock);
+    return statistics;
+}
+
+- (void)resetStatistics
+{
+    pthread_mutex_lock(&_lock);
+    [_samples removeAllObjects];
+    _peakResident = 0;
+    pthread_mutex_unlock(&_lock);
+    [[ODLoadBackend sharedBackend] resetCounters];
+}
+
+- (NSString*)report
+{
+    NSDictionary* statistics = [self statistics];
+    NSMutableString* report = [NSMutableString new];
+    [report appendFormat:@"%-16s %8s %7s %9s %9s %9s %9s %9s %9s\n",
+                         "workload", "count", "errors", "ops/s", "p50 ms", "p95 ms", "p99 ms", "p99.9 ms", "max ms"];
+    for (NSString* workload in [statistics.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+        NSDictionary* s = statistics[workload];
+        [report appendFormat:@"%-16s %8lu %7lu %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+                             workload.UTF8String,
+                             [s[@"count"] unsignedLongValue], [s[@"errors"] unsignedLongValue],
+                             [s[@"throughput"] doubleValue], [s[@"p50"] doubleValue], [s[@"p95"] doubleValue],
+                             [s[@"p99"] doubleValue], [s[@"p999"] doubleValue], [s[@"max"] doubleValue]];
+    }
+
+    pthread_mutex_lock(&_lock);
+    uint64_t peak = _peakResident;
+    pthread_mutex_unlock(&_lock);
+    [report appendFormat:@"\nresident memory %.1f MB, peak %.1f MB\n", ODLoadResidentBytes() / 1048576.0, peak / 1048576.0];
+
+    ODLoadBackend* backend = [ODLoadBackend sharedBackend];
+    [report appendFormat:@"\n%-16s %8s %9s %9s\n", "round trip", "calls", "injected", "throttled"];
+    for (NSInteger operation = 0; operation < kODLoadOperationCount; operation++) {
+        [report appendFormat:@"%-16s %8lu %9lu %9lu\n",
+                             ODLoadOperationName(operation).UTF8String,
+                             (unsigned long)[backend callsForOperation:operation],
+                             (unsigned long)[backend injectedErrorsForOperation:operation],
+                             (unsigned long)[backend throttledCallsForOperation:operation]];
+    }
+    [report appendString:@"\nquery counts synchronous results only, batched and run-loop queries run at the node's own pace\n"];
+    return report;
+}
+
+@end
@@ -0,0 +1,144 @@
+//
+//  main.m
+//  ODManager
+//
+// Copyright (c) 2014 Eldon Ahrold ( https://github.com/eahrold/ODManager )
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#import <Foundation/Foundation.h>
+#import <ODManager/ODManager.h>
+#import "ODLoadBackend.h"
+#import "ODLoadGenerator.h"
+
+/*
+ odmload - capacity testing for ODManager against a stand-in directory
+
+ Options are read from the argument domain, e.g.
+    odmload -server 127.0.0.1 -diradmin diradmin -password secret -users 100000 -groups 10000 -latency 5 -p99 50
+
+    -server          LDAP server to use as the backend, required unless -localNode YES
+    -localNode       use this machine's own local directory as the backend, it gets real accounts
+    -diradmin        admin record name
+    -password        admin password
+    -users           users to seed, default 100000
+    -groups          groups to seed, default 10000
+    -members         users seeded into each group, default 25
+    -concurrency     calls in flight, default 8
+    -operations      calls in the mixed run, default 10000
+    -mix             workload weights, default "import=1,sync=2,list=1,check=6"
+    -latency         median added round trip latency in ms, default 0
+    -p99             99th percentile added latency in ms, default 4 x latency
+    -errorRate       fraction of round trips that fail, default 0
+    -maxPerSecond    round trips per second of each kind the backend allows, default no limit
+    -membershipCache load the membership cache before the run
+    -seed            seed before the run, default YES
+    -cleanUp         remove everything that was created afterwards, default YES
+ */
+
+static NSDictionary* ODLoadParseMix(NSString* string)
+{
+    NSMutableDictionary* mix = [NSMutableDictionary new];
+    for (NSString* pair in [string componentsSeparatedByString:@","]) {
+        NSArray* parts = [pair componentsSeparatedByString:@"="];
+        if (parts.count == 2) {
+            mix[[parts[0] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]]] = @([parts[1] doubleValue]);
+        }
+    }
+    return mix;
+}
+
+int main(int argc, const char* argv[])
+{
+    @autoreleasepool
+    {
+        NSUserDefaults* defaults = [NSUserDefaults standardUserDefaults];
+        [defaults registerDefaults:@{ @"users" : @100000,
+                                      @"groups" : @10000,
+                                      @"members" : @25,
+                                      @"concurrency" : @8,
+                                      @"operations" : @10000,
+                                      @"seed" : @YES,
+                                      @"cleanUp" : @YES }];
+
+        /* seeding writes real accounts, so the local directory is never picked by default */
+        NSString* server = [defaults stringForKey:@"server"];
+        BOOL localNode = [defaults boolForKey:@"localNode"];
+        if (!server.length && !localNode) {
+            fprintf(stderr, "odmload: -server is required, or pass -localNode YES to seed this machine's own directory\n");
+            return 2;
+        }
+
+        ODLoadBackend* backend = [ODLoadBackend sharedBackend];
+        double latency = [defaults doubleForKey:@"latency"];
+        double p99 = [defaults objectForKey:@"p99"] ? [defaults doubleForKey:@"p99"] : latency * 4;
+        ODLoadProfile* profile = [ODLoadProfile profileWithMedian:latency p99:p99 errorRate:[defaults doubleForKey:@"errorRate"]];
+        profile.maxPerSecond = [defaults doubleForKey:@"maxPerSecond"];
+        [backend setProfile:profile];
+        [backend install];
+
+        ODManager* manager = server.length ? [[ODManager alloc] initWithServer:server]
+                                           : [[ODManager alloc] initWithDomain:kODMLocalDomain];
+        manager.diradmin = [defaults stringForKey:@"diradmin"];
+        manager.diradminPassword = [defaults stringForKey:@"password"];
+
+        NSError* error;
+        if ([manager authenticate:&error] <= 0) {
+            fprintf(stderr, "odmload: could not authenticate: %s\n", error.localizedDescription.UTF8String);
+            return 1;
+        }
+
+        ODLoadGenerator* generator = [[ODLoadGenerator alloc] initWithManager:manager];
+        generator.users = [defaults integerForKey:@"users"];
+        generator.groups = [defaults integerForKey:@"groups"];
+        generator.membersPerGroup = [defaults integerForKey:@"members"];
+        generator.concurrency = MAX(1, [defaults integerForKey:@"concurrency"]);
+        generator.operations = [defaults integerForKey:@"operations"];
+        if ([defaults stringForKey:@"mix"]) {
+            generator.mix = ODLoadParseMix([defaults stringForKey:@"mix"]);
+        }
+
+        printf("backend: %s, %s\n", server.length ? server.UTF8String : "local node", profile.description.UTF8String);
+
+        if ([defaults boolForKey:@"seed"]) {
+            if (![generator seed:&error]) {
+                fprintf(stderr, "odmload: seeding finished with errors: %s\n", error.localizedDescription.UTF8String);
+            }
+            printf("\nseed\n%s", generator.report.UTF8String);
+            [generator resetStatistics];
+        }
+
+        if ([defaults boolForKey:@"membershipCache"] && ![manager loadMembershipCache:&error]) {
+            fprintf(stderr, "odmload: could not load the membership cache: %s\n", error.localizedDescription.UTF8String);
+        }
+
+        [generator run];
+        printf("\nrun\n%s", generator.report.UTF8String);
+
+        if ([defaults boolForKey:@"cleanUp"]) {
+            [generator resetStatistics];
+            if (![generator cleanUp:&error]) {
+                fprintf(stderr, "odmload: clean up finished with errors: %s\n", error.localizedDescription.UTF8String);
+            }
+            printf("\nclean up\n%s", generator.report.UTF8String);
+        }
+    }
+    return 0;
+}
@@ -7,6 +7,50 @@
 //
 
 #import <XCTest/XCTest.h>
+#import <ODManager/ODManager.h>
+#import <OpenDirectory/OpenDirectory.h>
+#import "ODMembershipCache.h"
+#import "ODManagerJournal.h"
+#import "ODGIDAllocator.h"
+#import "ODSearchIndex.h"
+
+/* stands in for an ODRecord, the exporter only asks for the name and details */
+@interface ODMTestRecord : NSObject
+@property (copy) NSString *recordName;
+@end
+
+@implementation ODMTestRecord
+- (NSDictionary *)recordDetailsForAttributes:(NSArray *)attributes error:(NSError **)error
+{
+    return @{ kODAttributeTypeRecordName : @[ self.recordName ] };
+}
+@end
+
+/* exports from a list of names, matching prefixes case sensitively like a strict node */
+@interface ODMTestExporter : ODManagerExporter
+@property (copy) NSArray *names;
+@property (copy) NSSet *unreadable;
+@property (strong) NSMutableArray *prefixes;
+@end
+
+@implementation ODMTestExporter
+- (NSArray *)recordsOfType:(NSString *)type prefix:(NSString *)prefix names:(NSArray *)names attributes:(NSArray *)attributes limit:(NSUInteger)limit node:(ODNode *)node error:(NSError **)error
+{
+    NSMutableArray *records = [NSMutableArray new];
+    @synchronized(self){
+        if(prefix)[self.prefixes addObject:prefix];
+    }
+    for(NSString *name in self.names){
+        BOOL match = prefix ? [name hasPrefix:prefix] : names ? [names containsObject:name] && ![self.unreadable containsObject:name] : YES;
+        if(!match)continue;
+        ODMTestRecord *record = [ODMTestRecord new];
+        record.recordName = name;
+        [records addObject:record];
+        if(limit && records.count == limit)break;
+    }
+    return records;
+}
+@end
 
 @interface ODManagerTests : XCTestCase
 
@@ -31,4 +75,198 @@
     XCTFail(@"No implementation for \"%s\"", __PRETTY_FUNCTION__);
 }
 
+- (ODMTestExporter *)exporterWithNames:(NSArray *)names
+{
+    ODMTestExporter *exporter = [[ODMTestExporter alloc] initWithNodes:@[ [NSObject new] ]];
+    exporter.names = names;
+    exporter.prefixes = [NSMutableArray new];
+    exporter.recordTypes = @[ kODRecordTypeUsers ];
+    exporter.pageSize = 5;
+    return exporter;
+}
+
+- (NSArray *)exportedNames:(NSData *)data
+{
+    NSMutableArray *names = [NSMutableArray new];
+    NSString *text = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+    for(NSString *line in [text componentsSeparatedByString:@"\n"]){
+        if(!line.length)continue;
+        NSDictionary *record = [NSJSONSerialization JSONObjectWithData:[line dataUsingEncoding:NSUTF8StringEncoding] options:0 error:nil];
+        [names addObject:record[@"name"]];
+    }
+    return names;
+}
+
+- (void)testExportSplitsFullShardsAndExportsEveryNameOnce
+{
+    /* "a" fills its page and is split; "a b" and "a@x" continue outside the alphabet, the rest start outside it */
+    NSMutableArray *names = [NSMutableArray arrayWithObjects:@"a", @"a b", @"a@x", @"Bob", @"\u00e9mile", @"@admin", @"zed", nil];
+    for(int i = 0; i < 30; i++){
+        [names addObject:[NSString stringWithFormat:@"a%02d", i]];
+    }
+    ODMTestExporter *exporter = [self exporterWithNames:names];
+
+    NSOutputStream *stream = [NSOutputStream outputStreamToMemory];
+    [stream open];
+    NSError *error;
+    XCTAssertTrue([exporter exportToStream:stream error:&error], @"%@", error);
+    NSArray *exported = [self exportedNames:[stream propertyForKey:NSStreamDataWrittenToMemoryStreamKey]];
+    [stream close];
+
+    XCTAssertTrue([exporter.prefixes containsObject:@"a1"], @"a full shard is split into longer prefixes");
+    XCTAssertEqual(exported.count, names.count, @"every record is written exactly once");
+    XCTAssertEqualObjects([NSSet setWithArray:exported], [NSSet setWithArray:names]);
+    XCTAssertEqual(exporter.exportedCount, names.count);
+    XCTAssertEqual(exporter.job.result.failureCount, (NSUInteger)0);
+}
+
+- (void)testExportFailsWhenAListedRecordIsNotExported
+{
+    ODMTestExporter *exporter = [self exporterWithNames:@[ @"alice", @"Bob" ]];
+    exporter.unreadable = [NSSet setWithObject:@"Bob"];
+
+    NSOutputStream *stream = [NSOutputStream outputStreamToMemory];
+    [stream open];
+    NSError *error;
+    XCTAssertFalse([exporter exportToStream:stream error:&error], @"a lossy export must not report success");
+    XCTAssertNotNil(error);
+    XCTAssertEqual(exporter.job.result.failureCount, (NSUInteger)1);
+    [stream close];
+}
+
+- (void)testClientOrderingMatchesTheServersStringOrdering
+{
+    ODManagerPredicate *greater = [ODManagerPredicate attribute:kODAttributeTypeUniqueID matches:kODMMatchGreaterThan value:@"20"];
+    XCTAssertFalse([greater evaluateWithValues:@{ kODAttributeTypeUniqueID : @[ @"100" ] }], @"\"100\" sorts before \"20\" as a string");
+    XCTAssertTrue([greater evaluateWithValues:@{ kODAttributeTypeUniqueID : @[ @"3" ] }]);
+
+    ODManagerPredicate *less = [ODManagerPredicate attribute:kODAttributeTypeRecordName matches:kODMMatchLessThan value:@"bob"];
+    XCTAssertTrue([less evaluateWithValues:@{ kODAttributeTypeRecordName : @[ @"Alice" ] }], @"ordering ignores case");
+}
+
+- (void)testMembershipCacheCollapsesNestingCyclesIntoTheClosure
+{
+    ODMembershipCache *cache = [ODMembershipCache new];
+    [cache addUsers:@[ @"alice" ] toGroup:@"staff"];
+    [cache addGroup:@"staff" toGroup:@"eng"];
+    [cache addGroup:@"eng" toGroup:@"all"];
+    [cache addGroup:@"all" toGroup:@"eng"];
+
+    XCTAssertEqual(cache.cycles.count, (NSUInteger)1);
+    XCTAssertEqualObjects([NSSet setWithArray:cache.cycles.firstObject], ([NSSet setWithObjects:@"eng", @"all", nil]));
+
+    NSSet *expected = [NSSet setWithObjects:@"staff", @"eng", @"all", nil];
+    XCTAssertEqualObjects([cache effectiveGroupsForUser:@"alice"], expected);
+    XCTAssertTrue([cache user:@"alice" isMemberOfGroup:@"all"]);
+    XCTAssertEqualObjects([cache effectiveMembersOfGroup:@"eng"], [NSSet setWithObject:@"alice"]);
+    XCTAssertFalse([cache user:@"alice" isMemberOfGroup:@"wheel"]);
+}
+
+- (void)testMembershipCacheKeepsOtherPathsAfterARemoval
+{
+    ODMembershipCache *cache = [ODMembershipCache new];
+    [cache addGroup:@"staff" toGroup:@"all"];
+    [cache addGroup:@"eng" toGroup:@"all"];
+    [cache addUsers:@[ @"alice" ] toGroup:@"staff"];
+    [cache addUsers:@[ @"alice", @"bob" ] toGroup:@"eng"];
+
+    [cache removeUsers:@[ @"alice" ] fromGroup:@"staff"];
+    XCTAssertFalse([cache user:@"alice" isMemberOfGroup:@"staff"]);
+    XCTAssertTrue([cache user:@"alice" isMemberOfGroup:@"all"], @"still reaches all through eng");
+    XCTAssertEqualObjects([cache effectiveMembersOfGroup:@"staff"], [NSSet set]);
+
+    [cache removeAllUsersFromGroup:@"eng"];
+    XCTAssertEqualObjects([cache effectiveGroupsForUser:@"alice"], [NSSet set]);
+    XCTAssertEqualObjects([cache effectiveMembersOfGroup:@"all"], [NSSet set]);
+}
+
+- (void)testJournalDropsAPartialTrailingLine
+{
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    [@"1\talice\n3\tbob\n1\tcar" writeToFile:path atomically:YES encoding:NSUTF8StringEncoding error:nil];
+
+    NSError *error;
+    ODManagerJournal *journal = [[ODManagerJournal alloc] initWithPath:path];
+    XCTAssertTrue([journal open:&error], @"%@", error);
+    XCTAssertEqual(journal.resumedCount, (NSUInteger)2, @"the unfinished line is not an entry");
+    XCTAssertTrue([journal hasCompletedStage:kODMJournalCreated forRecord:@"alice"]);
+    XCTAssertTrue([journal hasCompletedStage:kODMJournalCreated | kODMJournalPasswordSet forRecord:@"bob"]);
+    XCTAssertFalse([journal hasCompletedStage:kODMJournalCreated forRecord:@"car"]);
+
+    [journal markStage:kODMJournalCreated forRecord:@"carol"];
+    XCTAssertFalse([journal hadStageWhenOpened:kODMJournalCreated forRecord:@"carol"], @"marked by this run");
+    [journal close];
+
+    ODManagerJournal *reopened = [[ODManagerJournal alloc] initWithPath:path];
+    XCTAssertTrue([reopened open:&error], @"%@", error);
+    XCTAssertTrue([reopened hadStageWhenOpened:kODMJournalCreated forRecord:@"carol"]);
+    XCTAssertFalse([reopened hasCompletedStage:kODMJournalCreated forRecord:@"car"], @"the fragment was cut off, not finished");
+    XCTAssertEqual(reopened.resumedCount, (NSUInteger)3);
+    [reopened close];
+
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+- (void)testGIDAllocatorNeverHandsOutIDsPastTheRange
+{
+    ODGIDAllocator *allocator = [[ODGIDAllocator alloc] initWithFirstID:100 lastID:102];
+    XCTAssertEqual(allocator.available, (NSUInteger)3);
+    XCTAssertEqual([allocator allocateID], (NSUInteger)100);
+    XCTAssertEqual([allocator allocateID], (NSUInteger)101);
+    XCTAssertEqual([allocator allocateID], (NSUInteger)102);
+    XCTAssertEqual([allocator allocateID], (NSUInteger)NSNotFound, @"the rest of the last word is not free");
+    XCTAssertEqual(allocator.available, (NSUInteger)0);
+}
+
+- (void)testGIDAllocatorWrapsAroundToReleasedIDs
+{
+    ODGIDAllocator *allocator = [[ODGIDAllocator alloc] initWithFirstID:1 lastID:130];
+    NSMutableArray *used = [NSMutableArray new];
+    for(NSUInteger gid = 1; gid <= 128; gid++){
+        [used addObject:[@(gid) stringValue]];
+    }
+    [allocator markUsed:used];
+
+    XCTAssertEqual([allocator allocateID], (NSUInteger)129);
+    [allocator releaseID:5];
+    XCTAssertEqual([allocator allocateID], (NSUInteger)130, @"IDs are handed out in increasing order before wrapping");
+    XCTAssertEqual([allocator allocateID], (NSUInteger)5);
+    XCTAssertEqual([allocator allocateID], (NSUInteger)NSNotFound);
+}
+
+- (void)testGIDAllocatorClaimsAndReleasesInsideAndOutsideTheRange
+{
+    ODGIDAllocator *allocator = [ODGIDAllocator new];
+    NSUInteger available = allocator.available;
+
+    XCTAssertTrue([allocator claimID:1025]);
+    XCTAssertFalse([allocator claimID:1025]);
+    XCTAssertEqual(allocator.available, available - 1);
+    XCTAssertEqual([allocator allocateID], (NSUInteger)1026, @"a claimed ID is not handed out");
+    [allocator releaseID:1025];
+    XCTAssertTrue([allocator claimID:1025]);
+
+    XCTAssertTrue([allocator claimID:20]);
+    XCTAssertFalse([allocator claimID:20]);
+    [allocator releaseID:20];
+    XCTAssertTrue([allocator claimID:20]);
+    XCTAssertFalse([allocator claimID:NSNotFound]);
+}
+
+- (void)testSearchIndexUpdatesReplaceAndMergeEntries
+{
+    ODSearchIndex *index = [ODSearchIndex new];
+    [index setValuesByName:@{ @"jdoe" : @[ @"John Doe" ], @"asmith" : @[ @"Anne Smith" ] } type:kODRecordTypeUsers];
+    [index setValuesByName:@{ @"jdoe" : @[ @"Jane Doe" ], @"bsmith" : @[ @"Bob Smith" ] } type:kODRecordTypeUsers];
+
+    XCTAssertEqualObjects([index namesOfType:kODRecordTypeUsers withPrefix:@"john" limit:0], @[], @"the old values are gone");
+    XCTAssertEqualObjects([index namesOfType:kODRecordTypeUsers withPrefix:@"JA" limit:0], @[ @"jdoe" ]);
+    XCTAssertEqualObjects([index namesOfType:kODRecordTypeUsers withPrefix:@"smi" limit:0], (@[ @"asmith", @"bsmith" ]), @"untouched names stay, new ones merge in order");
+    XCTAssertEqualObjects([index namesOfType:kODRecordTypeUsers withPrefix:@"smi" limit:1], @[ @"asmith" ]);
+    XCTAssertEqualObjects([index namesOfType:kODRecordTypeGroups withPrefix:@"smi" limit:0], @[]);
+
+    [index removeNames:@[ @"asmith" ] type:kODRecordTypeUsers];
+    XCTAssertEqualObjects([index namesOfType:kODRecordTypeUsers withPrefix:@"smi" limit:0], @[ @"bsmith" ]);
+}
+
 @end